@@ -45,6 +45,9 @@ using tinyxml2::XMLElement;
 
 namespace Sim {
 
+	// per-thread frame arena size used when AppConfig does not specify one
+	const size_t SIM_FRAME_ARENA_DEFAULT_SIZE = 1 << 20;
+
 	Driver* Driver::_instance = new LinuxDriver ();
 
 	LinuxDriver::~LinuxDriver () {Cleanup ();}
@@ -63,8 +66,33 @@ namespace Sim {
 			return false;
 		}
 
-		// Initialize the event manager (always the first module to be initialized)
-		XMLElement* element = parser.GetElement ("EventManager");
+		/**
+		 * Initialize the per-frame scratch arena (always the first module to be
+		 * initialized, so that every manager can allocate from it).
+		 */
+		XMLElement* element = parser.GetElement ("FrameArena");
+		size_t bytesPerThread = SIM_FRAME_ARENA_DEFAULT_SIZE;
+		if (element != nullptr && element->Attribute ("BytesPerThread") != nullptr){
+			bytesPerThread = static_cast <size_t> (element->UnsignedAttribute ("BytesPerThread"));
+		}
+		if (!InitializeFrameArena (bytesPerThread)){
+			return false;
+		}
+		element = nullptr;
+
+		// optional memory budgets (one element per tag)
+		element = parser.GetElement ("MemoryBudget");
+		while (element != nullptr){
+			if (!InitializeMemoryBudget (*element)){
+				Cleanup ();
+				return false;
+			}
+			element = element->NextSiblingElement ("MemoryBudget");
+		}
+		element = nullptr;
+
+		// Initialize the event manager
+		element = parser.GetElement ("EventManager");
 		if (element == nullptr){
 			LOG_ERROR ("Event manager profile not found in " << config);
 			return false;
@@ -183,14 +211,32 @@ namespace Sim {
 
 	void LinuxDriver::Run ()
 	{
+		// the render manager clears the window that the Render updates of the graph draw into, so it
+		// does not overlap the next frame: pipelined frames overlap rendering and physics within the graph
+		while (_runFlag){
+			_taskManager->Update ();
+			_eventManager->Run ();
+			_renderManager->Update ();
 
+			// all per-frame scratch memory is released at the end of the step
+			_frameArena->Reset ();
+		}
 	}
 
 	void LinuxDriver::Cleanup ()
 	{
+		// tasks hold on to the asset components
+		_taskManager.reset ();
 		_assetManager.reset ();
 		_pluginManager.reset ();
 		_eventManager.reset ();
+
+		// memory reports (printed once, by the first cleanup after initialization)
+		if (_frameArena){
+			_frameArena->Report ();
+			_frameArena.reset ();
+			MemoryTracker::Instance ().Report ();
+		}
 	}
 
 	bool LinuxDriver::InitializeRenderManager (const char* config)
@@ -232,7 +278,7 @@ namespace Sim {
 #		else
 		_taskManager = make_unique <TaskManager> ();
 #		endif
-		if (!_renderManager->Initialize (config)){
+		if (!_taskManager->Initialize (config)){
 			LOG_ERROR ("Task manager could not be initialize with " << config);
 			return false;
 		}
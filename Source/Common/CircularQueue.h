@@ -5,66 +5,89 @@
  * See LICENSE.txt included in this package
  *
  * @section DESCRIPTION
- * Template for thread-safe circular queue.
+ * Template for thread-safe circular queue with blocking Push () and Pop ().
+ * It wraps the lock-free RingBuffer: operations that succeed right away
+ * never take the mutex; a thread only locks it to sleep on a full or an
+ * empty queue, and the other side only locks it to wake a sleeper. The
+ * size must be a power of two and all 'size' slots are usable.
  */
 #pragma once
 
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
 
+#include "RingBuffer.h"
+
 namespace Sim {
 
 	template <class T, unsigned int size> class CircularQueue {
 
 		private:
+			RingBuffer <T, size> _ring;
+
 			std::mutex _mutex;
 			std::condition_variable _full, _empty;
-
-			unsigned int _readIndex = 0;
-			unsigned int _writeIndex = 0;
-			T _queue [size];
+			std::atomic <unsigned int> _pushWaiters {0};
+			std::atomic <unsigned int> _popWaiters {0};
 
 		public:
 			CircularQueue () = default;
 			~CircularQueue () = default;
+
 			void Push (const T& e)
 			{
-				std::unique_lock <std::mutex> loki (_mutex);
-				while (Full ()) {
-					_full.wait (loki);
+				if (!_ring.TryPush (e)){
+					std::unique_lock <std::mutex> loki (_mutex);
+					_pushWaiters.fetch_add (1);
+					std::atomic_thread_fence (std::memory_order_seq_cst);
+					_full.wait (loki, [&] () {return _ring.TryPush (e);});
+					_pushWaiters.fetch_sub (1);
 				}
-
-				_queue [Index (_writeIndex)] = e;
-				_writeIndex = Index (_writeIndex + 1);
-
-				_empty.notify_one ();
+				Wake (_popWaiters, _empty);
 			}
 
 			void Pop (T& result)
 			{
-				std::unique_lock <std::mutex> loki (_mutex);
-				while (Empty ()) {
-					_empty.wait (loki);
+				if (!_ring.TryPop (result)){
+					std::unique_lock <std::mutex> loki (_mutex);
+					_popWaiters.fetch_add (1);
+					std::atomic_thread_fence (std::memory_order_seq_cst);
+					_empty.wait (loki, [&] () {return _ring.TryPop (result);});
+					_popWaiters.fetch_sub (1);
 				}
-
-				result = _queue [Index (_readIndex)];
-				_readIndex = Index (_readIndex + 1);
-
-				_full.notify_one ();
+				Wake (_pushWaiters, _full);
 			}
 
-		protected:
-			bool Full ()
+			bool TryPush (const T& e)
 			{
-				return (_writeIndex -_readIndex == size - 1) || (_writeIndex == _readIndex - 1);
+				if (!_ring.TryPush (e)){
+					return false;
+				}
+				Wake (_popWaiters, _empty);
+				return true;
 			}
-			bool Empty ()
+
+			bool TryPop (T& result)
 			{
-				return (_writeIndex == _readIndex);
+				if (!_ring.TryPop (result)){
+					return false;
+				}
+				Wake (_pushWaiters, _full);
+				return true;
 			}
-			unsigned int Index (const unsigned int index)
+
+			bool Empty () const {return _ring.Empty ();}
+
+		protected:
+			// the fence orders our ring update before reading the waiter count
+			void Wake (std::atomic <unsigned int>& waiters, std::condition_variable& condition)
 			{
-				return index % size;
+				std::atomic_thread_fence (std::memory_order_seq_cst);
+				if (waiters.load (std::memory_order_relaxed) > 0){
+					std::lock_guard <std::mutex> loki (_mutex);
+					condition.notify_all ();
+				}
 			}
 	};
 }
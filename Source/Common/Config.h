@@ -13,6 +13,8 @@
 /* #undef SIM_THREAD_SCHEDULER_ENABLED */
 
 #define SIM_LOG_ENABLED
+#define SIM_MEMORY_STATS_ENABLED
+#define SIM_TASK_PROFILER_ENABLED
 /* #undef SIM_VECTOR3_ENABLED */
 #define SIM_VECTOR4_ENABLED
 /* #undef SIM_DOUBLE_PRECISION */
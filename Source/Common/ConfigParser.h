@@ -28,6 +28,7 @@ namespace Sim {
 
 			bool Initialize (const char* inputfile, const char* rootName);
 			const char* DocName () const;
+			tinyxml2::XMLElement* GetRoot () {return _root ? _root->ToElement () : nullptr;}
 			tinyxml2::XMLElement* GetElement (const char*, tinyxml2::XMLElement* root = nullptr);
 
 	};
@@ -22,6 +22,8 @@ namespace Sim {
 #	define SIM_ARCH_32 1
 #	define SIM_ARCH_64 2
 
+#	define SIM_CACHE_LINE_SIZE 64
+
 	// set precision
 #	ifdef SIM_DOUBLE_PRECISION
 		typedef double Real;
@@ -32,9 +34,9 @@ namespace Sim {
 #	endif
 
 	// common lambda functions
-	auto DELETE_ARRAY = [] (auto a) { delete [] a; };
-	auto SAFE_DELETE = [] (auto x){ if (x != nullptr) {delete x; x = nullptr;} };
-	auto ABSOLUTE = [] (auto f) { return f > 0. ? f : -f; };
-	auto SIGN = [] (auto x) { return x > 0. ? 1 : -1; };
-	auto MAX = [] (auto x, auto y) { return x > y ? x : y; };
+	static auto DELETE_ARRAY = [] (auto a) { delete [] a; };
+	static auto SAFE_DELETE = [] (auto x){ if (x != nullptr) {delete x; x = nullptr;} };
+	static auto ABSOLUTE = [] (auto f) { return f > 0. ? f : -f; };
+	static auto SIGN = [] (auto x) { return x > 0. ? 1 : -1; };
+	static auto MAX = [] (auto x, auto y) { return x > y ? x : y; };
 }
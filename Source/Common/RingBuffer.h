@@ -0,0 +1,152 @@
+/**
+ * @file RingBuffer.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Template for a bounded, lock-free, multi-producer/multi-consumer ring
+ * buffer (after Dmitry Vyukov's design). Every slot carries a sequence
+ * number that tells producers and consumers whether the slot is free for
+ * the current lap or holds data, so a push or a pop is a single CAS on
+ * the write or read position and never blocks. The capacity must be a
+ * power of two, so indexing is a mask, and every slot is usable.
+ * PushN () and PopN () claim several consecutive slots with one CAS.
+ * T must be default constructible and copy assignable.
+ */
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+
+#include "Preprocess.h"
+
+namespace Sim {
+
+	template <class T, unsigned int Capacity> class RingBuffer {
+
+		static_assert (Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Ring buffer capacity must be a power of two");
+
+		private:
+			struct Slot {
+				std::atomic <size_t> _sequence;
+				T _data;
+			};
+
+			static const size_t Mask = Capacity - 1;
+
+			// read and write positions are padded onto their own cache lines (padding
+			// rather than alignas, since C++14 heap allocation ignores over-alignment)
+			unsigned char _pad0 [SIM_CACHE_LINE_SIZE];
+			std::atomic <size_t> _writeIndex {0};
+			unsigned char _pad1 [SIM_CACHE_LINE_SIZE - sizeof (std::atomic <size_t>)];
+			std::atomic <size_t> _readIndex {0};
+			unsigned char _pad2 [SIM_CACHE_LINE_SIZE - sizeof (std::atomic <size_t>)];
+			Slot _slots [Capacity];
+
+		public:
+			RingBuffer ()
+			{
+				for (size_t i = 0; i < Capacity; ++i){
+					_slots [i]._sequence.store (i, std::memory_order_relaxed);
+				}
+			}
+			~RingBuffer () = default;
+
+			RingBuffer (const RingBuffer&) = delete;
+			RingBuffer& operator = (const RingBuffer&) = delete;
+
+			// returns false if the ring is full
+			bool TryPush (const T& e)
+			{
+				return PushN (&e, 1) == 1;
+			}
+
+			// returns false if the ring is empty
+			bool TryPop (T& result)
+			{
+				return PopN (&result, 1) == 1;
+			}
+
+			/**
+			 * Pushes up to 'count' elements into consecutive slots and returns the
+			 * number pushed (zero if the ring is full).
+			 */
+			unsigned int PushN (const T* e, unsigned int count)
+			{
+				size_t position = _writeIndex.load (std::memory_order_relaxed);
+				unsigned int n = 0;
+				while (true){
+					// count the free slots following the write position
+					n = 0;
+					while (n < count && _slots [(position + n) & Mask]._sequence.load (std::memory_order_acquire) == position + n){
+						++n;
+					}
+					if (n == 0){
+						// the first slot is either still being read (ring full) or already claimed
+						size_t sequence = _slots [position & Mask]._sequence.load (std::memory_order_acquire);
+						if (static_cast <ptrdiff_t> (sequence - position) < 0){
+							return 0;
+						}
+						position = _writeIndex.load (std::memory_order_relaxed);
+						continue;
+					}
+					if (_writeIndex.compare_exchange_weak (position, position + n, std::memory_order_relaxed)){
+						break;
+					}
+				}
+
+				for (unsigned int i = 0; i < n; ++i){
+					Slot& s = _slots [(position + i) & Mask];
+					s._data = e [i];
+					s._sequence.store (position + i + 1, std::memory_order_release);
+				}
+				return n;
+			}
+
+			/**
+			 * Pops up to 'count' elements from consecutive slots into 'result' and
+			 * returns the number popped (zero if the ring is empty).
+			 */
+			unsigned int PopN (T* result, unsigned int count)
+			{
+				size_t position = _readIndex.load (std::memory_order_relaxed);
+				unsigned int n = 0;
+				while (true){
+					// count the published slots following the read position
+					n = 0;
+					while (n < count && _slots [(position + n) & Mask]._sequence.load (std::memory_order_acquire) == position + n + 1){
+						++n;
+					}
+					if (n == 0){
+						// the first slot is either not yet written (ring empty) or already claimed
+						size_t sequence = _slots [position & Mask]._sequence.load (std::memory_order_acquire);
+						if (static_cast <ptrdiff_t> (sequence - (position + 1)) < 0){
+							return 0;
+						}
+						position = _readIndex.load (std::memory_order_relaxed);
+						continue;
+					}
+					if (_readIndex.compare_exchange_weak (position, position + n, std::memory_order_relaxed)){
+						break;
+					}
+				}
+
+				for (unsigned int i = 0; i < n; ++i){
+					Slot& s = _slots [(position + i) & Mask];
+					result [i] = s._data;
+					s._sequence.store (position + i + Capacity, std::memory_order_release);
+				}
+				return n;
+			}
+
+			// approximate number of elements (exact only when no other thread is active)
+			size_t Size () const
+			{
+				size_t w = _writeIndex.load (std::memory_order_relaxed);
+				size_t r = _readIndex.load (std::memory_order_relaxed);
+				return w > r ? w - r : 0;
+			}
+			bool Empty () const {return Size () == 0;}
+	};
+}
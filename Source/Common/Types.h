@@ -44,7 +44,7 @@ namespace Sim {
 		 return output;
 	 }
 
-	 auto ManagerTypeByName = [=] (const char* chr)
+	 static auto ManagerTypeByName = [] (const char* chr)
 	 {
 		 string str (chr);
 		 if (!str.compare ("EventManager")){
@@ -86,7 +86,7 @@ namespace Sim {
 		 return output;
 	 }
 
-	 auto RenderManagerTypeByName = [=] (const char* chr)
+	 static auto RenderManagerTypeByName = [] (const char* chr)
 	 {
 		 string str (chr);
 		 if (!str.compare ("GLManager")){
@@ -119,7 +119,7 @@ namespace Sim {
 		 return output;
 	 }
 
-	 auto ComputeManagerTypeByName = [=] (const char* chr)
+	 static auto ComputeManagerTypeByName = [] (const char* chr)
 	 {
 		 string str (chr);
 		 if (!str.compare ("CudaManager")){
@@ -152,7 +152,7 @@ namespace Sim {
 		 return output;
 	 }
 
-	 auto TaskManagerTypeByName = [=] (const char* chr)
+	 static auto TaskManagerTypeByName = [] (const char* chr)
 	 {
 		 string str (chr);
 		 if (!str.compare ("TbbManager")){
@@ -197,7 +197,7 @@ namespace Sim {
 		 return output;
 	 }
 
-	 auto PluginTypeByName = [=] (const char* chr)
+	 static auto PluginTypeByName = [] (const char* chr)
 	 {
 		 string str (chr);
 		 if (!str.compare ("Rigid")){
@@ -260,7 +260,7 @@ namespace Sim {
 		 return output;
 	 }
 
-	 auto AssetIdByName = [=] (const char* chr)
+	 static auto AssetIdByName = [] (const char* chr)
 	 {
 		 string str (chr);
 		 if (!str.compare ("LeftKidney")){
@@ -311,7 +311,7 @@ namespace Sim {
 		 return output;
 	 }
 
-	 auto AssetTypeByName = [=] (const char* chr)
+	 static auto AssetTypeByName = [] (const char* chr)
 	 {
 		 string str (chr);
 		 if (!str.compare ("Rigid")){
@@ -348,7 +348,7 @@ namespace Sim {
 		 return output;
 	 }
 
-	 auto AssetComponentTypeByName = [=] (const char* chr)
+	 static auto AssetComponentTypeByName = [] (const char* chr)
 	 {
 		 string str (chr);
 		 if (!str.compare ("Geometry")){
@@ -389,7 +389,7 @@ namespace Sim {
 		 return output;
 	 }
 
-	 auto ProgramIdByName = [=] (const char* chr)
+	 static auto ProgramIdByName = [] (const char* chr)
 	 {
 		 string str (chr);
 		 if (!str.compare ("Normal")){
@@ -407,4 +407,52 @@ namespace Sim {
 		 return ProgramId::Unknown;
 	 };
 
+	 enum class MemoryTag {
+		General,
+		Geometry,
+		Physics,
+		RenderStaging,
+		Events,
+		Tools,
+		Unknown
+	 };
+
+	 inline ostream& operator << (ostream& output, const MemoryTag& id)
+	 {
+		 switch (id){
+		 case MemoryTag::General: output << "General"; break;
+		 case MemoryTag::Geometry: output << "Geometry"; break;
+		 case MemoryTag::Physics: output << "Physics"; break;
+		 case MemoryTag::RenderStaging: output << "RenderStaging"; break;
+		 case MemoryTag::Events: output << "Events"; break;
+		 case MemoryTag::Tools: output << "Tools"; break;
+		 default: output << "Unknown"; break;
+		 }
+		 return output;
+	 }
+
+	 static auto MemoryTagByName = [] (const char* chr)
+	 {
+		 string str (chr);
+		 if (!str.compare ("General")){
+			 return MemoryTag::General;
+		 }
+		 else if (!str.compare ("Geometry")){
+			 return MemoryTag::Geometry;
+		 }
+		 else if (!str.compare ("Physics")){
+			 return MemoryTag::Physics;
+		 }
+		 else if (!str.compare ("RenderStaging")){
+			 return MemoryTag::RenderStaging;
+		 }
+		 else if (!str.compare ("Events")){
+			 return MemoryTag::Events;
+		 }
+		 else if (!str.compare ("Tools")){
+			 return MemoryTag::Tools;
+		 }
+		 return MemoryTag::Unknown;
+	 };
+
 }
@@ -0,0 +1,138 @@
+/**
+ * @file WorkStealingDeque.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Template for the Chase-Lev work-stealing deque (with the memory orders
+ * of Le et al., "Correct and Efficient Work-Stealing for Weak Memory
+ * Models"). The owner thread pushes and pops at the bottom without any
+ * atomic read-modify-write, except when it races a thief for the last
+ * item. Any other thread steals from the top with one CAS. The circular
+ * array doubles when full; retired arrays are kept until the deque is
+ * destroyed, since a thief may still be reading from one.
+ * T must be trivially copyable (typically a pointer).
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "Preprocess.h"
+
+namespace Sim {
+
+	template <class T> class WorkStealingDeque {
+
+		private:
+			struct Array {
+				int64_t _mask;
+				std::unique_ptr <std::atomic <T> []> _items;
+
+				explicit Array (int64_t size): _mask (size - 1), _items (new std::atomic <T> [size]) {}
+
+				int64_t Size () const {return _mask + 1;}
+				T Get (int64_t i) const {return _items [i & _mask].load (std::memory_order_relaxed);}
+				void Put (int64_t i, T x) {_items [i & _mask].store (x, std::memory_order_relaxed);}
+			};
+
+			// thieves touch _top, the owner mostly _bottom (padded apart)
+			std::atomic <int64_t> _top {0};
+			unsigned char _pad0 [SIM_CACHE_LINE_SIZE];
+			std::atomic <int64_t> _bottom {0};
+			std::atomic <Array*> _array;
+			unsigned char _pad1 [SIM_CACHE_LINE_SIZE];
+
+			// owner only
+			std::vector <std::unique_ptr <Array> > _arrays;
+
+		public:
+			// capacity must be a power of two
+			explicit WorkStealingDeque (int64_t capacity = 256)
+			{
+				_arrays.emplace_back (new Array (capacity));
+				_array.store (_arrays.back ().get (), std::memory_order_relaxed);
+			}
+			~WorkStealingDeque () = default;
+
+			WorkStealingDeque (const WorkStealingDeque&) = delete;
+			WorkStealingDeque& operator = (const WorkStealingDeque&) = delete;
+
+			// owner thread only
+			void Push (T x)
+			{
+				int64_t b = _bottom.load (std::memory_order_relaxed);
+				int64_t t = _top.load (std::memory_order_acquire);
+				Array* a = _array.load (std::memory_order_relaxed);
+				if (b - t > a->Size () - 1){
+					a = Grow (a, b, t);
+				}
+				a->Put (b, x);
+				// publishes the item to thieves (same as a release fence and a relaxed store)
+				_bottom.store (b + 1, std::memory_order_release);
+			}
+
+			// owner thread only, newest item first
+			bool Pop (T& x)
+			{
+				int64_t b = _bottom.load (std::memory_order_relaxed) - 1;
+				Array* a = _array.load (std::memory_order_relaxed);
+				_bottom.store (b, std::memory_order_relaxed);
+				std::atomic_thread_fence (std::memory_order_seq_cst);
+				int64_t t = _top.load (std::memory_order_relaxed);
+
+				if (t > b){
+					// empty
+					_bottom.store (b + 1, std::memory_order_relaxed);
+					return false;
+				}
+				x = a->Get (b);
+				if (t == b){
+					// last item: race the thieves for it
+					bool won = _top.compare_exchange_strong (t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+					_bottom.store (b + 1, std::memory_order_relaxed);
+					return won;
+				}
+				return true;
+			}
+
+			// any thread, oldest item first. May fail spuriously when racing another thief
+			bool Steal (T& x)
+			{
+				int64_t t = _top.load (std::memory_order_acquire);
+				std::atomic_thread_fence (std::memory_order_seq_cst);
+				int64_t b = _bottom.load (std::memory_order_acquire);
+				if (t >= b){
+					return false;
+				}
+				Array* a = _array.load (std::memory_order_acquire);
+				x = a->Get (t);
+				return _top.compare_exchange_strong (t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			}
+
+			// approximate when called concurrently
+			size_t Size () const
+			{
+				int64_t b = _bottom.load (std::memory_order_relaxed);
+				int64_t t = _top.load (std::memory_order_relaxed);
+				return b > t ? static_cast <size_t> (b - t) : 0;
+			}
+			bool Empty () const {return Size () == 0;}
+
+		private:
+			Array* Grow (Array* a, int64_t b, int64_t t)
+			{
+				Array* grown = new Array (2*a->Size ());
+				for (int64_t i = t; i < b; ++i){
+					grown->Put (i, a->Get (i));
+				}
+				_arrays.emplace_back (grown);
+				_array.store (grown, std::memory_order_release);
+				return grown;
+			}
+	};
+}
@@ -73,21 +73,18 @@ namespace Sim {
 		_components.clear ();
 	}
 
-	bool Asset::Load (XMLElement& elem)
+	shared_ptr <ConfigParser> Asset::ReadConfig (const char* config)
 	{
-		// get the name of the config file for the asset
-		const char* config = elem.Attribute ("Config");
-		if (config == nullptr){
-			LOG_ERROR ("No config file specified for " << elem.Attribute ("Name"));
-			return false;
-		}
-
-		ConfigParser parser;
-		if (!parser.Initialize (config, "AssetConfig")){
+		shared_ptr <ConfigParser> parser = make_shared <ConfigParser> ();
+		if (!parser->Initialize (config, "AssetConfig")){
 			LOG_ERROR ("Could not initialize parser for " << config);
-			return false;
+			parser.reset ();
 		}
+		return parser;
+	}
 
+	bool Asset::Load (XMLElement& elem, ConfigParser& parser)
+	{
 		XMLElement* clist = elem.FirstChildElement ("Component");
 
 		while (clist != nullptr){
@@ -105,7 +102,7 @@ namespace Sim {
 
 			XMLElement* telem = parser.GetElement (type);
 			if (telem == nullptr){
-				LOG_ERROR ("No specification for " << type << " found in " << config);
+				LOG_ERROR ("No specification for " << type << " found in " << elem.Attribute ("Config"));
 				return false;
 			}
 
@@ -115,7 +112,7 @@ namespace Sim {
 				return false;
 			}
 			if (!p->AddAssetComponent (*telem, AssetComponentTypeByName (type), const_cast <Asset*> (this))){
-				LOG_ERROR ("Could not initialize " << type << " component from " << config);
+				LOG_ERROR ("Could not initialize " << type << " component from " << elem.Attribute ("Config"));
 				return false;
 			}
 
@@ -20,11 +20,13 @@
 #include "Preprocess.h"
 #include "Log.h"
 #include "Types.h"
+#include "Memory/Memory.h"
 #include "Asset/Component.h"
 
 namespace Sim {
 
 	class AssetManager;
+	class ConfigParser;
 
 	class EXPORT Asset {
 
@@ -32,7 +34,7 @@ namespace Sim {
 
 	protected:
 		AssetType _type = AssetType::Unknown;
-		std::map <AssetComponentType, std::shared_ptr <Assets::Component> > _components;
+		PooledMap <AssetComponentType, std::shared_ptr <Assets::Component> > _components;
 
 	public:
 		Asset (AssetType t) : _type (t) {};
@@ -43,6 +45,7 @@ namespace Sim {
 		Asset& operator = (const Asset&) = delete;
 
 		AssetType Type () const {return _type;}
+		bool Has (AssetComponentType id) const {return _components.find (id) != _components.end ();}
 
 		bool Initialize (tinyxml2::XMLElement& element);
 		void Cleanup ();
@@ -73,7 +76,11 @@ namespace Sim {
 #			endif
 		}
 
+		// reads an asset config file, null on failure (safe on any thread)
+		static std::shared_ptr <ConfigParser> ReadConfig (const char* config);
+
 	protected:
-		bool Load (tinyxml2::XMLElement& element);
+		// creates the components from the asset config (see ReadConfig ())
+		bool Load (tinyxml2::XMLElement& element, ConfigParser& parser);
 	};
 }
@@ -8,8 +8,11 @@
  * See AssetManager.h.
  */
 
+#include <future>
 #include <map>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "tinyxml2.h"
 
@@ -17,12 +20,17 @@
 #include "Log.h"
 
 #include "ConfigParser.h"
+#include "Driver/Driver.h"
+#include "Tasks/IOExecutor.h"
+#include "Tasks/TaskManager.h"
 #include "Asset/Asset.h"
 #include "Asset/AssetManager.h"
 
 using std::map;
 using std::shared_ptr;
 using std::make_shared;
+using std::string;
+using std::vector;
 using tinyxml2::XMLElement;
 
 namespace Sim {
@@ -49,6 +57,7 @@ namespace Sim {
 			Cleanup ();
 			return false;
 		}
+		StructureChanged ();
 		LOG ("Asset manager initialized");
 		return true;
 	}
@@ -56,6 +65,7 @@ namespace Sim {
 	void AssetManager::Cleanup ()
 	{
 		_assets.clear ();
+		StructureChanged ();
 	}
 
 	bool AssetManager::Add (AssetId id, shared_ptr <Asset> asset)
@@ -65,6 +75,19 @@ namespace Sim {
 			return false;
 		}
 		_assets [id] = move (asset);
+		StructureChanged ();
+		return true;
+	}
+
+	bool AssetManager::Remove (AssetId id)
+	{
+		auto f = _assets.find (id);
+		if (f == _assets.end () || f->second.get () == nullptr){
+			LOG_ERROR (id << " does not exist. Asset not removed");
+			return false;
+		}
+		_assets.erase (f);
+		StructureChanged ();
 		return true;
 	}
 
@@ -147,13 +170,47 @@ namespace Sim {
 			alist = alist->NextSiblingElement ("Asset");
 		}
 
-		// initialize components now
-		alist = element.FirstChildElement ("Asset");
+		// initialize components now, the task manager reads the files if it runs already
+		TaskManager* tasks = Driver::Instance ().GetTaskManager ();
+		// continuations of the own I/O threads run in place
+		TaskManager serial;
+		IOExecutor own;
+		if (tasks == nullptr){
+			own.Initialize (serial, SIM_IO_DEFAULT_THREADS, vector <unsigned int> ());
+		}
+		_loader = tasks != nullptr ? &tasks->IO () : &own;
+		bool loaded = LoadComponents (element, *_loader);
+		_loader = nullptr;
+		return loaded;
+	}
+
+	bool AssetManager::LoadComponents (XMLElement& element, IOExecutor& io)
+	{
+		// read all the asset configs at once
+		vector <std::shared_future <shared_ptr <ConfigParser> > > configs;
+		XMLElement* alist = element.FirstChildElement ("Asset");
 
 		while (alist != nullptr){
 
+			const char* config = alist->Attribute ("Config");
+			if (config == nullptr){
+				LOG_ERROR ("No config file specified for " << alist->Attribute ("Name"));
+				return false;
+			}
+			string file (config);
+			configs.push_back (io.Submit (IOPriority::Urgent, [file] () {return Asset::ReadConfig (file.c_str ());}));
+
+			alist = alist->NextSiblingElement ("Asset");
+		}
+
+		// and load the components in order as their configs come in
+		alist = element.FirstChildElement ("Asset");
+
+		for (size_t i = 0; alist != nullptr; ++i){
+
 			auto a = _assets.find (AssetIdByName (alist->Attribute ("Name")));
-			if (!a->second->Load (*alist)){
+			shared_ptr <ConfigParser> parser = configs [i].get ();
+			if (parser == nullptr || !a->second->Load (*alist, *parser)){
 				LOG_ERROR ("Could not load components for " << a->first);
 				return false;
 			}
@@ -5,23 +5,36 @@
  * See LICENSE.txt included in this package
  *
  * @section DESCRIPTION
- * The factory class for assets in the Canvas framework.
+ * The factory class for assets in the Canvas framework. Adding or removing
+ * an asset, or changing the components of one (e.g. a cut splitting its
+ * mesh), bumps the structure count, so the task graphs built from the
+ * assets know to rebuild themselves. The config files of the assets are
+ * read concurrently on I/O threads (the task manager's, or a few of its
+ * own before the task manager exists), while the components are created
+ * in order on the loading thread, which holds the render and compute
+ * contexts.
  */
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <map>
 
 #include "Types.h"
+#include "Memory/Memory.h"
 
 namespace Sim {
 
 	class Asset;
+	class IOExecutor;
 
 	class AssetManager {
 
 	protected:
-		std::map <AssetId, std::shared_ptr <Asset> > _assets;
+		PooledMap <AssetId, std::shared_ptr <Asset> > _assets;
+		std::atomic <unsigned int> _structure {0};
+		// reads the asset files while assets load, null otherwise
+		IOExecutor* _loader = nullptr;
 
 	public:
 		AssetManager () = default;
@@ -34,9 +47,19 @@ namespace Sim {
 		void Cleanup ();
 
 		bool Add (AssetId id, std::shared_ptr <Asset> asset);
+		bool Remove (AssetId id);
 		std::shared_ptr <Asset> Get (AssetId id);
 
+		// changes with every structural change of the assets
+		unsigned int Structure () const {return _structure.load (std::memory_order_acquire);}
+		// to be called by the driver thread, between frames, after changing the components of an asset
+		void StructureChanged () {_structure.fetch_add (1, std::memory_order_acq_rel);}
+
+		// executor of the file reads of the loading assets, null when not loading
+		IOExecutor* Loader () {return _loader;}
+
 	protected:
 		bool Load (tinyxml2::XMLElement&);
+		bool LoadComponents (tinyxml2::XMLElement&, IOExecutor&);
 	};
 }
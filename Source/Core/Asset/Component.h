@@ -9,7 +9,8 @@
  * framework. Different kinds of components derive from this class.
  * Each component is responsible for loading and managing its own data.
  * Each asset can own different types of components in a mix-and-match
- * sense.
+ * sense. Components declare the asset data their update reads and writes
+ * (see Access ()), from which the task managers order the updates.
  */
 #pragma once
 
@@ -22,6 +23,31 @@ namespace Sim {
 
 	class Asset;
 
+	// per-asset data touched by component updates
+	enum class AssetData : unsigned int {
+		CurrentGeometry = 1 << 0,
+		PreviousGeometry = 1 << 1,
+		PhysicsState = 1 << 2,
+		Contacts = 1 << 3,
+		// the geometry of the last finished frame: the current buffer, or the
+		// previous one when frames are pipelined (resolved by the task graph)
+		PresentedGeometry = 1 << 4
+	};
+	// kinds of data tracked by the task graph, PresentedGeometry being an alias
+	const unsigned int SIM_ASSET_DATA_KINDS = 4;
+
+	inline unsigned int operator | (AssetData a, AssetData b) {return static_cast <unsigned int> (a) | static_cast <unsigned int> (b);}
+	inline unsigned int operator | (unsigned int a, AssetData b) {return a | static_cast <unsigned int> (b);}
+
+	// AssetData bits read and written by one update
+	struct DataAccess {
+		// of the asset owning the component
+		unsigned int _reads = 0;
+		unsigned int _writes = 0;
+		// of the other assets it interacts with (contacts etc.)
+		unsigned int _readsOthers = 0;
+	};
+
 	namespace Assets {
 
 		class Component {
@@ -43,6 +69,36 @@ namespace Sim {
 				virtual bool Initialize (tinyxml2::XMLElement& config, Asset* asset) = 0;
 				virtual void Update () = 0;
 				virtual void Cleanup () = 0;
+
+				// data the update touches, by component type unless a component knows better
+				virtual DataAccess Access () const
+				{
+					DataAccess access;
+					switch (Type ()){
+						case AssetComponentType::Geometry:
+							// flips the current and previous buffers
+							access._writes = AssetData::CurrentGeometry | AssetData::PreviousGeometry;
+							break;
+						case AssetComponentType::Physics:
+							access._reads = AssetData::PreviousGeometry | AssetData::PhysicsState | AssetData::Contacts;
+							access._writes = AssetData::CurrentGeometry | AssetData::PhysicsState;
+							break;
+						case AssetComponentType::Collision:
+						case AssetComponentType::Intersection:
+							access._reads = static_cast <unsigned int> (AssetData::CurrentGeometry);
+							access._writes = static_cast <unsigned int> (AssetData::Contacts);
+							access._readsOthers = static_cast <unsigned int> (AssetData::CurrentGeometry);
+							break;
+						case AssetComponentType::Render:
+							access._reads = static_cast <unsigned int> (AssetData::PresentedGeometry);
+							break;
+						default:
+							// unknown updates conflict with everything on their asset
+							access._reads = access._writes = (1u << SIM_ASSET_DATA_KINDS) - 1;
+							break;
+					}
+					return access;
+				}
 		};
 	}
 }
@@ -9,7 +9,9 @@
  */
 
 #include <string>
+#include <future>
 #include <memory>
+#include <vector>
 
 #include "tinyxml2.h"
 
@@ -19,6 +21,9 @@
 
 #include "Vector.h"
 #include "MeshUtils.h"
+#include "Memory/MemoryTracker.h"
+#include "Driver/Driver.h"
+#include "Tasks/TaskManager.h"
 #include "Asset/Geometry.h"
 
 using std::string;
@@ -100,6 +105,10 @@ namespace Sim {
 			_vertices.reset ();
 			_faces.reset ();
 			_subsets.reset ();
+			_subsetCosts.Cleanup ();
+
+			MemoryTracker::Instance ().Free (MemoryTag::Geometry, _trackedBytes);
+			_trackedBytes = 0;
 		}
 
 		bool Geometry::ReadVertexFile (const char* file)
@@ -107,8 +116,11 @@ namespace Sim {
 			_numVertices = MeshUtils::MeshFileElementCount (file);
 
 			// allocate vertex array and load it from file
-			_vertices = make_unique <Vector []> (2*_numVertices);
-			if (!_vertices){
+			if (!TrackMemory (2*_numVertices*sizeof (Vector))){
+				LOG_ERROR ("Vertex array of size " << 2*_numVertices << " for " << file << " exceeds memory budget");
+				return false;
+			}
+			if (!_vertices.Allocate (2*_numVertices, Driver::Instance ().GetTaskManager ())){
 				LOG_ERROR ("Could not allocate vertex array of size " << 2*_numVertices << " for " << file);
 				return false;
 			}
@@ -148,49 +160,99 @@ namespace Sim {
 		{
 			_subsets = make_unique <Geometry::SpatialSubset []> (_numSubsets);
 
-			// get total number of faces
+			// the files are read on the I/O threads, or on this thread if there are none
+			IOExecutor inlined;
+			IOExecutor* shared = Driver::Instance ().GetIOExecutor ();
+			IOExecutor& io = shared != nullptr ? *shared : inlined;
+			std::vector <string> files (_numSubsets);
 			for (unsigned int i = 0; i < _numSubsets; ++i){
-				string file (prefix);
-				file += ".";
-				file += std::to_string (i);
-				file += ".tri";
+				files [i] = prefix;
+				files [i] += ".";
+				files [i] += std::to_string (i);
+				files [i] += ".tri";
+			}
 
+			// get total number of faces
+			std::vector <std::shared_future <int> > counts (_numSubsets);
+			for (unsigned int i = 0; i < _numSubsets; ++i){
+				const string& file = files [i];
+				counts [i] = io.Submit (IOPriority::Urgent, [&file] () {return MeshUtils::MeshFileElementCount (file.c_str ());});
+			}
+			for (unsigned int i = 0; i < _numSubsets; ++i){
 				SpatialSubset* s = &(_subsets.get () [i]);
-				s->_isize = MeshUtils::MeshFileElementCount (file.c_str ());
+				s->_isize = counts [i].get ();
 				s->_ioffset = 3*_numFaces;
 				_numFaces += s->_isize;
 			}
 
 			// initialize face index array
-			_faces = make_unique <unsigned int []> (3*_numFaces);
+			if (!TrackMemory (_numSubsets*sizeof (SpatialSubset) + 3*_numFaces*sizeof (unsigned int))){
+				LOG_ERROR ("Face index array of size " << 3*_numFaces << " exceeds memory budget");
+				return false;
+			}
+			if (!_faces.Allocate (3*_numFaces, Driver::Instance ().GetTaskManager ())){
+				LOG_ERROR ("Could not allocate face index array of size " << 3*_numFaces);
+				return false;
+			}
 
+			// each subset reads into its own part of the array
+			std::vector <std::shared_future <bool> > loads (_numSubsets);
 			for (unsigned int i = 0; i < _numSubsets; ++i){
-				string file (prefix);
-				file += ".";
-				file += std::to_string (i);
-				file += ".tri";
+				const string& file = files [i];
+				unsigned int* f = &(_faces [_subsets [i]._ioffset]);
+				loads [i] = io.Submit (IOPriority::Urgent, [&file, f] () {return MeshUtils::IndexLoad <3> (file.c_str (), f);});
+			}
 
+			// initial cost of a subset: its triangles and the vertices they span
+			std::vector <double> weights (_numSubsets, 0.0);
+			bool loaded = true;
+			for (unsigned int i = 0; i < _numSubsets; ++i){
 				SpatialSubset* s = &(_subsets [i]);
 				unsigned int* f = &(_faces [s->_ioffset]);
-				if (!MeshUtils::IndexLoad <3> (file.c_str (), f)){
-					LOG_ERROR ("Could not load index file " <<  file);
-					return false;
+				// every read has to finish before returning, they refer to 'files'
+				if (!loads [i].get ()){
+					LOG_ERROR ("Could not load index file " <<  files [i]);
+					loaded = false;
+				}
+				if (!loaded || s->_isize == 0){
+					continue;
 				}
 
 				// calculate the offset of vertex
 				unsigned int min = f [0];
+				unsigned int max = f [0];
 				for (unsigned int j = 1; j < 3*s->_isize; ++j){
 					if (min > f [j]){
 						min = f [j];
 					}
+					if (max < f [j]){
+						max = f [j];
+					}
 				}
 				s->_voffset = min;
+				weights [i] = s->_isize + (max - min + 1);
 
-				s->UpdateBound (CurrentVertexBuffer (), f);
+				// the face indices are global, UpdateBound () takes them relative to the subset
+				s->UpdateBound (CurrentVertexBuffer () + s->_voffset, f);
+			}
+			if (!loaded){
+				return false;
 			}
+			_subsetCosts.Initialize (weights);
 			return true;
 		}
 
+		void Geometry::UpdateSubsetBounds (TaskManager& tasks)
+		{
+			Vector* vertices = CurrentVertexBuffer ();
+			tasks.PartitionedFor (_subsetCosts, [this, vertices] (size_t index) {
+				SpatialSubset& s = _subsets [index];
+				if (s._isize > 0){
+					s.UpdateBound (vertices + s._voffset, &(_faces [s._ioffset]));
+				}
+			});
+		}
+
 		void Geometry::UpdateSurfaceVertexCount ()
 		{
 			unsigned int* f = _faces.get ();
@@ -204,5 +266,14 @@ namespace Sim {
 			++_numSurfaceVertices;
 		}
 
+		bool Geometry::TrackMemory (size_t bytes)
+		{
+			if (!MemoryTracker::Instance ().Allocate (MemoryTag::Geometry, bytes)){
+				return false;
+			}
+			_trackedBytes += bytes;
+			return true;
+		}
+
 	}
 }
@@ -7,7 +7,18 @@
  * @section DESCRIPTION
  * The geometry component interface for the Asset class in the Canvas
  * class. It's derived from the generic Component interface. Geometry
- * holds all the vertices and face-indices for any asset.
+ * holds all the vertices and face-indices for any asset. The vertices are
+ * double buffered: physics reads the previous buffer and writes the
+ * current one, and Update () flips them. When frames are pipelined, the
+ * consumers of a finished frame (rendering etc.) read the previous buffer
+ * while physics computes the next frame into the current one.
+ * The faces are split into 8^Depth spatial subsets of uneven size. Passes
+ * over the subsets should go through TaskManager::PartitionedFor () with
+ * SubsetPartition (), whose costs start from the triangle and vertex
+ * counts of each subset and follow the measured times from then on.
+ * Nothing calls UpdateSubsetBounds () at run time yet: the only physics
+ * (CuglMsd) moves the vertices on the GPU. A CPU physics pass should call
+ * it once it has written the current vertices.
  */
 #pragma once
 
@@ -15,9 +26,14 @@
 
 #include "Vector.h"
 #include "AxisAlignedBox.h"
+#include "Memory/HugePage.h"
+#include "Tasks/WorkPartition.h"
 #include "Asset/Component.h"
 
 namespace Sim {
+
+	class TaskManager;
+
 	namespace Assets {
 
 		auto toggle = [=] (int val) {return val ^ (0 ^ 1);};
@@ -67,13 +83,21 @@ namespace Sim {
 			unsigned int _offsetSize = 0;
       unsigned int _numVertices = 0;
       unsigned int _numSurfaceVertices = 0;
-      std::unique_ptr <Vector []> _vertices;
+      HugeBuffer <Vector> _vertices;
 
 			unsigned int _numFaces = 0;
-			std::unique_ptr <unsigned int []> _faces;
+			HugeBuffer <unsigned int> _faces;
 
       unsigned int _numSubsets = 1;
       std::unique_ptr <SpatialSubset []> _subsets;
+			// costs of the passes over the subsets
+			WorkPartition _subsetCosts;
+
+			// bytes charged to MemoryTag::Geometry
+			size_t _trackedBytes = 0;
+
+			// set by the task manager when it overlaps physics and rendering
+			bool _pipelined = false;
 
 		public:
 			Geometry () = default;
@@ -89,6 +113,19 @@ namespace Sim {
 			unsigned int SurfaceVertexCount () const {return _numSurfaceVertices;}
 			Vector* PreviousVertexBuffer () {return &(_vertices.get () [toggle (_offsetIndex)*_numVertices]);}
 			Vector* CurrentVertexBuffer () {return &(_vertices.get () [_offsetIndex*_numVertices]);}
+			// the last finished frame, for reading only (see AssetData::PresentedGeometry)
+			Vector* PresentedVertexBuffer () {return _pipelined ? PreviousVertexBuffer () : CurrentVertexBuffer ();}
+
+			bool IsPipelined () const {return _pipelined;}
+			void SetPipelined (bool pipelined) {_pipelined = pipelined;}
+
+			unsigned int SubsetCount () const {return _numSubsets;}
+			unsigned int SubsetFaceCount (unsigned int index) const {return _subsets [index]._isize;}
+			const AxisAlignedBox& SubsetBound (unsigned int index) const {return _subsets [index]._bound;}
+			// cost model of the subsets (reweighted by plugins that know better, e.g. by spring counts)
+			WorkPartition& SubsetPartition () {return _subsetCosts;}
+			// refits the subset bounds to the current vertex buffer, in parallel over the subsets
+			void UpdateSubsetBounds (TaskManager& tasks);
 
 			unsigned int FaceIndexCount () const {return _numFaces;}
 			unsigned int* FaceIndexBuffer () {return _faces.get ();}
@@ -110,6 +147,8 @@ namespace Sim {
 			bool ReadVertexFile (const char* file);
 			bool ReadIndexFiles (const char* prefix);
 			void UpdateSurfaceVertexCount ();
+
+			bool TrackMemory (size_t bytes);
 		};
 	}
 }
@@ -8,13 +8,18 @@
  * See Driver.h.
  */
 
+#include <cstring>
 #include <memory>
 
+#include "tinyxml2.h"
+
 #include "Log.h"
 #include "Plugin/SharedLib.h"
 #include "Driver/Driver.h"
 
 using std::make_unique;
+using tinyxml2::XMLElement;
+using tinyxml2::XML_SUCCESS;
 
 namespace Sim {
 
@@ -47,4 +52,36 @@ namespace Sim {
 		}
 		return true;
 	}
+
+	bool Driver::InitializeFrameArena (size_t bytesPerThread)
+	{
+		_frameArena = make_unique <FrameArena> ();
+		if (!_frameArena->Initialize (bytesPerThread)){
+			LOG_ERROR ("Frame arena could not be initialized with " << bytesPerThread << " bytes per thread");
+			return false;
+		}
+		return true;
+	}
+
+	// reads <MemoryBudget Tag="Geometry" Megabytes="512" Policy="Log|Fail"/>
+	bool Driver::InitializeMemoryBudget (XMLElement& element)
+	{
+		const char* name = element.Attribute ("Tag");
+		if (name == nullptr || MemoryTagByName (name) == MemoryTag::Unknown){
+			LOG_ERROR ("Invalid memory budget tag " << (name == nullptr ? "(none)" : name));
+			return false;
+		}
+		unsigned int megabytes = 0;
+		if (element.QueryUnsignedAttribute ("Megabytes", &megabytes) != XML_SUCCESS){
+			LOG_ERROR ("Could not read memory budget size of " << name);
+			return false;
+		}
+		BudgetPolicy policy = BudgetPolicy::Log;
+		const char* p = element.Attribute ("Policy");
+		if (p != nullptr && !strcmp (p, "Fail")){
+			policy = BudgetPolicy::Fail;
+		}
+		MemoryTracker::Instance ().SetBudget (MemoryTagByName (name), size_t (megabytes) << 20, policy);
+		return true;
+	}
 }
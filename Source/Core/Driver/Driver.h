@@ -31,6 +31,9 @@
 
 #include "Tasks/TaskManager.h"
 
+#include "Memory/FrameArena.h"
+#include "Memory/MemoryTracker.h"
+
 namespace Sim {
 
 	class Driver {
@@ -46,6 +49,9 @@ namespace Sim {
 		std::unique_ptr <AssetManager> _assetManager;
 		std::unique_ptr <TaskManager> _taskManager;
 
+		// scratch memory for the current simulation step (reset every frame)
+		std::unique_ptr <FrameArena> _frameArena;
+
 		Driver () = default;
 		Driver (const Driver&) = delete;
 		Driver& operator = (const Driver&) = delete;
@@ -62,6 +68,18 @@ namespace Sim {
 		void Quit () {_runFlag = false;}
 
 		RenderManager* GetRenderManager () {return _renderManager.get ();}
+		EventManager* GetEventManager () {return _eventManager.get ();}
+		TaskManager* GetTaskManager () {return _taskManager.get ();}
+		// executor of blocking reads: the task manager's, or the one loading the assets before it exists
+		IOExecutor* GetIOExecutor ()
+		{
+			if (_taskManager){
+				return &_taskManager->IO ();
+			}
+			return _assetManager ? _assetManager->Loader () : nullptr;
+		}
+		FrameArena* GetFrameArena () {return _frameArena.get ();}
+		MemoryTracker& GetMemoryTracker () {return MemoryTracker::Instance ();}
 
 		bool AddPlugin (PluginType id, std::unique_ptr <Plugin>& plugin)
 		{
@@ -79,14 +97,27 @@ namespace Sim {
 			return _pluginManager->Get (id);
 		}
 
+		bool RemoveAsset (AssetId id)
+		{
+			return _assetManager->Remove (id);
+		}
+
 		std::shared_ptr <Asset> GetAsset (AssetId id)
 		{
 			return _assetManager->Get (id);
 		}
 
+		// structure count of the assets (see AssetManager::Structure ())
+		unsigned int AssetStructure () const
+		{
+			return _assetManager ? _assetManager->Structure () : 0;
+		}
+
 	protected:
 		virtual bool InitializeEventManager (const char* config);
 		virtual bool InitializePluginManager (const char* config);
 		virtual bool InitializeAssetManager (const char* config);
+		virtual bool InitializeFrameArena (size_t bytesPerThread);
+		virtual bool InitializeMemoryBudget (tinyxml2::XMLElement& element);
 	};
 }
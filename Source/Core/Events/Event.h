@@ -5,13 +5,23 @@
  * See LICENSE.txt included in this package
  *
  * @section DESCRIPTION
- * The interface to an event in the Chimera system. This is further
- * defined by derived classes for specific event types. Note that the
- * driver/app layer should have access to all types of events that can
- * be generated by the whole system.
+ * The interface to an event in the Chimera system. Besides the asset and
+ * event type, an event may carry a typed payload (contact data etc.)
+ * stored inline in a fixed-size buffer, so events stay trivially copyable
+ * and move through the event queue without any heap allocation. Payload
+ * types must be trivially copyable, fit in SIM_EVENT_PAYLOAD_SIZE bytes
+ * and declare their PayloadType as 'static const PayloadType Type' (see
+ * Events/EventPayloads.h). Note that the driver/app layer should have
+ * access to all types of events that can be generated by the whole system.
  */
 #pragma once
 
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+#include "Preprocess.h"
 #include "Asset/Asset.h"
 
 namespace Sim {
@@ -24,11 +34,52 @@ namespace Sim {
 		EVENT_INVALID
 	};
 
+	// event type from its name in config files ("Render" for EVENT_RENDER etc.)
+	inline EventType EventTypeByName (const char* name)
+	{
+		if (name == nullptr){
+			return EventType::EVENT_INVALID;
+		}
+		else if (!strcmp (name, "Intersection")){
+			return EventType::EVENT_INTERSECTION;
+		}
+		else if (!strcmp (name, "Physics")){
+			return EventType::EVENT_PHYSICS;
+		}
+		else if (!strcmp (name, "Collision")){
+			return EventType::EVENT_COLLISION;
+		}
+		else if (!strcmp (name, "Render")){
+			return EventType::EVENT_RENDER;
+		}
+		return EventType::EVENT_INVALID;
+	}
+
+	enum class PayloadType : unsigned char {
+		Empty,
+		Contact,
+		Intersection
+	};
+
+	// inline payload capacity (48 bytes in single precision)
+	const unsigned int SIM_EVENT_PAYLOAD_SIZE = 12*sizeof (Real);
+	const unsigned int SIM_EVENT_PAYLOAD_ALIGNMENT = 8;
+
 	class Event {
 
 		public:
 			unsigned int _assetId = 0;
 			EventType _eventId = EventType::EVENT_INVALID;
+			PayloadType _payloadType = PayloadType::Empty;
+			// number of events coalesced into this one
+			unsigned short _count = 1;
+			// graph task that raised the event (see EventManager::SetProducer ()) and the
+			// number of the event among those it raised, set when the event is queued
+			unsigned short _producer = 0;
+			unsigned short _sequence = 0;
+
+		private:
+			alignas (SIM_EVENT_PAYLOAD_ALIGNMENT) unsigned char _payload [SIM_EVENT_PAYLOAD_SIZE];
 
 		public:
 			Event () = default;
@@ -39,8 +90,45 @@ namespace Sim {
 
 			Event (unsigned int id, EventType ev): _assetId (id), _eventId (ev) {}
 
+			template <class T> Event (unsigned int id, EventType ev, const T& payload): _assetId (id), _eventId (ev)
+			{
+				SetPayload (payload);
+			}
+
 			inline EventType GetEventType () const {return _eventId;}
 			inline unsigned int GetAssetId () const {return _assetId;}
+			inline PayloadType GetPayloadType () const {return _payloadType;}
+
+			template <class T> inline void SetPayload (const T& payload)
+			{
+				static_assert (sizeof (T) <= SIM_EVENT_PAYLOAD_SIZE, "Event payload too large");
+				static_assert (alignof (T) <= SIM_EVENT_PAYLOAD_ALIGNMENT, "Event payload over-aligned");
+				static_assert (std::is_trivially_copyable <T>::value, "Event payload must be trivially copyable");
+				new (_payload) T (payload);
+				_payloadType = T::Type;
+			}
+
+			// returns the payload if it is of type T, nullptr otherwise
+			template <class T> inline const T* Payload () const
+			{
+				static_assert (sizeof (T) <= SIM_EVENT_PAYLOAD_SIZE, "Event payload too large");
+				return _payloadType == T::Type ? reinterpret_cast <const T*> (_payload) : nullptr;
+			}
+			template <class T> inline T* Payload ()
+			{
+				static_assert (sizeof (T) <= SIM_EVENT_PAYLOAD_SIZE, "Event payload too large");
+				return _payloadType == T::Type ? reinterpret_cast <T*> (_payload) : nullptr;
+			}
+
+			// raw payload bytes, for serialization
+			inline const unsigned char* PayloadData () const {return _payload;}
+			inline void SetPayloadData (PayloadType type, const void* data, size_t size)
+			{
+				memcpy (_payload, data, size < SIM_EVENT_PAYLOAD_SIZE ? size : SIM_EVENT_PAYLOAD_SIZE);
+				_payloadType = type;
+			}
 	};
-}
 
+	static_assert (std::is_trivially_copyable <Event>::value, "Events are copied through the event queue byte by byte");
+	static_assert (sizeof (Event) == 16 + SIM_EVENT_PAYLOAD_SIZE, "Event header must fit in 16 bytes");
+}
@@ -8,46 +8,684 @@
  * See EventManager.h.
  */
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
 #include "Log.h"
-#include "CircularQueue.h"
+#include "RingBuffer.h"
+#include "ConfigParser.h"
+#include "Driver/Driver.h"
 #include "Events/EventManager.h"
+#include "Events/EventPayloads.h"
+
+using tinyxml2::XMLElement;
 
 namespace Sim {
 
+	namespace {
+		std::atomic <unsigned int> instances {0};
+
+		// outbox of the calling thread, valid while instance matches the manager,
+		// and the graph task it runs with the number of its next event
+		struct LocalOutbox {
+			unsigned int _instance = 0;
+			void* _outbox = nullptr;
+			unsigned short _producer = 0;
+			unsigned short _sequence = 0;
+		};
+		thread_local LocalOutbox local;
+	}
+
+	EventManager::EventManager (): _instance (++instances)
+	{
+		for (EventLane& lane : _lanes){
+			lane = EventLane::SameFrame;
+		}
+		_scratch.Initialize (SIM_EVENT_QUEUE_SIZE*sizeof (Event));
+	}
+
 	EventManager::~EventManager () {Cleanup ();}
 
-	bool EventManager::AddListener (const EventListener& l, EventType e, unsigned int a)
+	ListenerId EventManager::AddListener (const EventListener& l, EventType e, unsigned int a)
+	{
+		unsigned int type = static_cast <unsigned int> (e);
+		if (type >= NumEventTypes){
+			LOG_ERROR ("Cannot listen to invalid event type");
+			return 0;
+		}
+		if (!l){
+			LOG_ERROR ("Cannot add empty event listener");
+			return 0;
+		}
+
+		Listener listener {++_index, l};
+		if (a == SIM_EVENT_ALL_ASSETS){
+			_wildcards [type].push_back (listener);
+		}
+		else {
+			if (a >= SIM_EVENT_MAX_ASSETS){
+				LOG_ERROR ("Asset id " << a << " out of range for event listeners");
+				return 0;
+			}
+			if (a >= _listeners [type].size ()){
+				_listeners [type].resize (a + 1);
+			}
+			_listeners [type][a].push_back (listener);
+		}
+		return listener._id;
+	}
+
+	bool EventManager::RemoveListener (ListenerId id)
+	{
+		auto remove = [id] (ListenerList& list) {
+			for (auto it = list.begin (); it != list.end (); ++it){
+				if (it->_id == id){
+					list.erase (it);
+					return true;
+				}
+			}
+			return false;
+		};
+
+		for (unsigned int t = 0; t < NumEventTypes; ++t){
+			if (remove (_wildcards [t])){
+				return true;
+			}
+			for (ListenerList& list : _listeners [t]){
+				if (remove (list)){
+					return true;
+				}
+			}
+		}
+		LOG_WARNING ("Event listener " << id << " not found");
+		return false;
+	}
+
+	bool EventManager::QueueEvent (const Event& e)
+	{
+		if (_replayer){
+			return true;
+		}
+		return Enqueue (e);
+	}
+
+	bool EventManager::Enqueue (const Event& e)
+	{
+		unsigned int type = static_cast <unsigned int> (e._eventId);
+		if (type >= NumEventTypes){
+			LOG_WARNING ("Invalid event for asset " << e._assetId << " dropped");
+			return false;
+		}
+		if (_coalescers [type]._slots && Coalesce (_coalescers [type], e)){
+			return true;
+		}
+		if (_lanes [type] != EventLane::SameFrame){
+			return PushLane (_lanes [type], e);
+		}
+
+		Outbox* outbox = LocalOutbox ();
+		if (outbox != nullptr){
+			while (outbox->_lock.test_and_set (std::memory_order_acquire)){
+			}
+			outbox->_events.push_back (e);
+			outbox->_events.back ()._producer = local._producer;
+			outbox->_events.back ()._sequence = local._sequence++;
+			outbox->_lock.clear (std::memory_order_release);
+			return true;
+		}
+
+		return PushLane (EventLane::SameFrame, e);
+	}
+
+	bool EventManager::PushLane (EventLane lane, const Event& e)
 	{
-		unsigned int key = a;
-		key |= static_cast <unsigned int> (e) << sizeof (unsigned short);
+		// never block the producer: a full queue drops the event
+		bool pushed = false;
+		switch (lane){
+			case EventLane::Immediate: pushed = _immediate.TryPush (e); break;
+			case EventLane::Deferred: pushed = _deferred.TryPush (e); break;
+			default: pushed = _queue.TryPush (e); break;
+		}
+		if (!pushed){
+			// dropping low priority events is expected under load, they are reported by Cleanup ()
+			if (lane != EventLane::Deferred){
+				LOG_WARNING ("Event queue full. Event " << static_cast <int> (e._eventId) << " for asset " << e._assetId << " dropped");
+			}
+			_laneCounters [static_cast <unsigned int> (lane)]._dropped.fetch_add (1, std::memory_order_relaxed);
+		}
+		return pushed;
+	}
+
+	bool EventManager::Coalesce (Coalescer& c, const Event& e)
+	{
+		// assets outside the slot table go through the queue uncoalesced
+		if (e._assetId >= SIM_EVENT_MAX_ASSETS){
+			return false;
+		}
+
+		Slot& slot = c._slots [e._assetId];
+		while (slot._lock.test_and_set (std::memory_order_acquire)){
+		}
+		bool first = !slot._pending;
+		if (first){
+			slot._event = e;
+			slot._event._count = 1;
+			slot._pending = true;
+		}
+		else {
+			Merge (c._policy, slot._event, e);
+		}
+		slot._lock.clear (std::memory_order_release);
 
-		_listeners.emplace (std::make_pair(key, l));
+		if (first){
+			c._dirty->TryPush (e._assetId);
+		}
+		else {
+			_coalesced.fetch_add (1, std::memory_order_relaxed);
+		}
 		return true;
 	}
 
-	bool EventManager::RemoveListener (const EventListener&, EventType e, unsigned int a)
+	void EventManager::Merge (CoalescePolicy policy, Event& pending, const Event& e)
+	{
+		unsigned short count = pending._count;
+		if (count < std::numeric_limits <unsigned short>::max ()){
+			++count;
+		}
+
+		if (policy == CoalescePolicy::KeepLatest){
+			pending = e;
+		}
+		else if (policy == CoalescePolicy::Accumulate){
+			if (pending._payloadType != e._payloadType){
+				// payloads of different kinds cannot be merged, the latest one wins
+				pending = e;
+			}
+			else if (e._payloadType == PayloadType::Contact){
+				AccumulateContact (*pending.Payload <ContactPayload> (), *e.Payload <ContactPayload> (), count);
+			}
+			else if (e._payloadType == PayloadType::Intersection){
+				pending = e;
+			}
+		}
+		pending._count = count;
+	}
+
+	void EventManager::AccumulateContact (ContactPayload& sum, const ContactPayload& contact, unsigned short count)
+	{
+		Real penetration [3];
+		Real length = 0;
+		for (unsigned int i = 0; i < 3; ++i){
+			sum._position [i] += (contact._position [i] - sum._position [i])/count;
+			penetration [i] = sum._normal [i]*sum._depth + contact._normal [i]*contact._depth;
+			length += penetration [i]*penetration [i];
+		}
+		length = std::sqrt (length);
+
+		// opposite contacts cancel out, the normal is kept for a zero depth
+		if (length > std::numeric_limits <Real>::epsilon ()){
+			for (unsigned int i = 0; i < 3; ++i){
+				sum._normal [i] = penetration [i]/length;
+			}
+		}
+		sum._depth = length;
+		if (sum._otherAsset != contact._otherAsset){
+			sum._otherAsset = SIM_EVENT_ALL_ASSETS;
+		}
+	}
+
+	size_t EventManager::DispatchCoalesced (Coalescer& c)
+	{
+		// slots made pending by listeners during this call wait for the next frame
+		unsigned int ids [SIM_EVENT_MAX_ASSETS];
+		unsigned int pending = c._dirty->PopN (ids, static_cast <unsigned int> (c._dirty->Size ()));
+
+		// the dirty list is in the order the slots were raised in, dispatch in asset order
+		std::sort (ids, ids + pending);
+		for (unsigned int i = 0; i < pending; ++i){
+			Slot& slot = c._slots [ids [i]];
+			while (slot._lock.test_and_set (std::memory_order_acquire)){
+			}
+			Event e = slot._event;
+			slot._pending = false;
+			slot._lock.clear (std::memory_order_release);
+
+			Dispatch (e);
+		}
+		return pending;
+	}
+
+	size_t EventManager::DispatchCoalescedLane (EventLane lane)
+	{
+		size_t dispatched = 0;
+		for (unsigned int t = 0; t < NumEventTypes; ++t){
+			if (_lanes [t] == lane && _coalescers [t]._slots){
+				dispatched += DispatchCoalesced (_coalescers [t]);
+			}
+		}
+		return dispatched;
+	}
+
+	EventManager::Outbox* EventManager::LocalOutbox () const
+	{
+		return local._instance == _instance ? static_cast <Outbox*> (local._outbox) : nullptr;
+	}
+
+	void EventManager::AttachThread ()
+	{
+		if (LocalOutbox () != nullptr){
+			return;
+		}
+
+		std::lock_guard <std::mutex> loki (_outboxMutex);
+		Outbox* outbox = nullptr;
+		for (auto& o : _outboxes){
+			if (!o->_attached){
+				outbox = o.get ();
+				break;
+			}
+		}
+		if (outbox == nullptr){
+			_outboxes.emplace_back (new Outbox);
+			outbox = _outboxes.back ().get ();
+		}
+		outbox->_attached = true;
+		local._instance = _instance;
+		local._outbox = outbox;
+	}
+
+	void EventManager::DetachThread ()
+	{
+		Outbox* outbox = LocalOutbox ();
+		if (outbox == nullptr){
+			return;
+		}
+
+		// pending events stay in the outbox until the next Run (), which may hand it to another thread
+		std::lock_guard <std::mutex> loki (_outboxMutex);
+		outbox->_attached = false;
+		local._instance = 0;
+		local._outbox = nullptr;
+	}
+
+	void EventManager::SetProducer (unsigned short producer)
+	{
+		local._producer = producer;
+		local._sequence = 0;
+	}
+
+	size_t EventManager::DispatchOutboxes ()
+	{
+		// the merged events only live until they are dispatched
+		FrameArena* arena = Driver::Instance ().GetFrameArena ();
+		FrameArena& scratch = arena != nullptr ? *arena : _scratch;
+		ArenaVector <Event> merged (scratch);
+		{
+			std::lock_guard <std::mutex> loki (_outboxMutex);
+			for (auto& o : _outboxes){
+				while (o->_lock.test_and_set (std::memory_order_acquire)){
+				}
+				for (const Event& e : o->_events){
+					merged.PushBack (e);
+				}
+				o->_events.clear ();
+				o->_lock.clear (std::memory_order_release);
+			}
+		}
+		size_t dispatched = merged.size ();
+
+		// thread independent order, the merge order breaks the remaining ties
+		ArenaVector <const Event*> order (scratch, dispatched);
+		for (const Event& e : merged){
+			order.PushBack (&e);
+		}
+		std::sort (order.begin (), order.end (), [] (const Event* a, const Event* b) {
+			if (a->_assetId != b->_assetId){
+				return a->_assetId < b->_assetId;
+			}
+			if (a->_eventId != b->_eventId){
+				return a->_eventId < b->_eventId;
+			}
+			if (a->_producer != b->_producer){
+				return a->_producer < b->_producer;
+			}
+			if (a->_sequence != b->_sequence){
+				return a->_sequence < b->_sequence;
+			}
+			return a < b;
+		});
+
+		for (const Event* e : order){
+			Dispatch (*e);
+		}
+		if (arena == nullptr){
+			_scratch.Reset ();
+		}
+		return dispatched;
+	}
+
+	void EventManager::CountDispatched (EventLane lane, size_t count)
+	{
+		LaneCounters& counters = _laneCounters [static_cast <unsigned int> (lane)];
+		counters._dispatched += count;
+		if (count > counters._peakDepth){
+			counters._peakDepth = count;
+		}
+	}
+
+	void EventManager::DispatchImmediate ()
+	{
+		size_t count = DispatchCoalescedLane (EventLane::Immediate);
+		count += Drain (_immediate);
+		CountDispatched (EventLane::Immediate, count);
+	}
+
+	void EventManager::DispatchDeferred ()
+	{
+		size_t pending = _deferred.Size ();
+		size_t count = 0;
+
+		auto deadline = std::chrono::steady_clock::now () + _deferredBudget;
+		while (pending > 0){
+			if (_deferredBudget.count () > 0 && std::chrono::steady_clock::now () >= deadline){
+				break;
+			}
+			size_t n = Drain (_deferred, pending < SIM_EVENT_DEFERRED_BATCH_SIZE ? pending : SIM_EVENT_DEFERRED_BATCH_SIZE);
+			if (n == 0){
+				break;
+			}
+			pending -= n;
+			count += n;
+		}
+		_laneCounters [static_cast <unsigned int> (EventLane::Deferred)]._carriedOver += pending;
+		CountDispatched (EventLane::Deferred, count);
+	}
+
+	void EventManager::Run ()
+	{
+		// events queued from here on are dispatched by the next call
+		unsigned int frame = _frame++;
+		if (_replayer){
+			// the recorded events are dispatched as they were, in their order
+			Event e;
+			while (_replayer->Next (frame, e)){
+				Dispatch (e);
+			}
+			return;
+		}
+		_recordFrame = frame - _recordStart;
+
+		DispatchImmediate ();
+
+		size_t count = DispatchCoalescedLane (EventLane::SameFrame);
+		count += DispatchOutboxes ();
+		count += Drain (_queue);
+		CountDispatched (EventLane::SameFrame, count);
+
+		DispatchDeferred ();
+	}
+
+	void EventManager::SetEventLane (EventType e, EventLane lane)
+	{
+		unsigned int type = static_cast <unsigned int> (e);
+		if (type >= NumEventTypes || lane == EventLane::NumLanes){
+			LOG_ERROR ("Cannot set lane of invalid event type");
+			return;
+		}
+		if (lane == EventLane::Deferred && _coalescers [type]._slots){
+			LOG_WARNING ("Deferred events are not coalesced, disabling coalescing for event type " << type);
+			SetCoalescePolicy (e, CoalescePolicy::KeepAll);
+		}
+		// must not be called while events are being queued
+		_lanes [type] = lane;
+	}
+
+	EventLane EventManager::GetEventLane (EventType e) const
+	{
+		unsigned int type = static_cast <unsigned int> (e);
+		return type < NumEventTypes ? _lanes [type] : EventLane::SameFrame;
+	}
+
+	EventLaneStats EventManager::GetLaneStats (EventLane lane) const
+	{
+		EventLaneStats stats;
+		if (lane == EventLane::NumLanes){
+			return stats;
+		}
+
+		const LaneCounters& counters = _laneCounters [static_cast <unsigned int> (lane)];
+		switch (lane){
+			case EventLane::Immediate: stats._depth = _immediate.Size (); break;
+			case EventLane::Deferred: stats._depth = _deferred.Size (); break;
+			default: stats._depth = _queue.Size (); break;
+		}
+		stats._peakDepth = counters._peakDepth;
+		stats._dispatched = counters._dispatched;
+		stats._dropped = counters._dropped.load (std::memory_order_relaxed);
+		stats._carriedOver = counters._carriedOver;
+		return stats;
+	}
+
+	void EventManager::SetCoalescePolicy (EventType e, CoalescePolicy policy)
+	{
+		unsigned int type = static_cast <unsigned int> (e);
+		if (type >= NumEventTypes){
+			LOG_ERROR ("Cannot set coalescing policy of invalid event type");
+			return;
+		}
+
+		if (policy != CoalescePolicy::KeepAll && _lanes [type] == EventLane::Deferred){
+			LOG_WARNING ("Deferred events are not coalesced, ignoring coalescing policy of event type " << type);
+			return;
+		}
+
+		// must not be called while events are being queued
+		Coalescer& c = _coalescers [type];
+		c._policy = policy;
+		if (policy == CoalescePolicy::KeepAll){
+			c._slots.reset ();
+			c._dirty.reset ();
+		}
+		else if (!c._slots){
+			c._slots.reset (new Slot [SIM_EVENT_MAX_ASSETS]);
+			c._dirty.reset (new RingBuffer <unsigned int, SIM_EVENT_MAX_ASSETS>);
+		}
+	}
+
+	CoalescePolicy EventManager::GetCoalescePolicy (EventType e) const
 	{
-		unsigned int key = a;
-		key |=  static_cast <unsigned int> (e) << sizeof (unsigned short);
+		unsigned int type = static_cast <unsigned int> (e);
+		return type < NumEventTypes ? _coalescers [type]._policy : CoalescePolicy::KeepAll;
+	}
 
-		_listeners.erase (key);
+	bool EventManager::StartRecording (const char* file)
+	{
+		if (_replayer){
+			LOG_ERROR ("Cannot record events while replaying");
+			return false;
+		}
+		StopRecording ();
+
+		std::unique_ptr <EventRecorder> recorder (new EventRecorder);
+		if (!recorder->Start (file)){
+			return false;
+		}
+		_recorder = std::move (recorder);
+		_recordStart = _frame.load ();
 		return true;
 	}
 
-	bool EventManager::QueueEvent (Event& e)
+	void EventManager::StopRecording ()
+	{
+		if (_recorder){
+			_recorder->Stop ();
+			_recorder.reset ();
+		}
+	}
+
+	bool EventManager::StartReplay (const char* file)
 	{
-		_queue.Push(e);
+		StopRecording ();
+
+		std::unique_ptr <EventReplayer> replayer (new EventReplayer);
+		if (!replayer->Open (file)){
+			return false;
+		}
+		_replayer = std::move (replayer);
+		_frame = 0;
 		return true;
 	}
 
 	bool EventManager::Initialize (const char* config)
 	{
+		ConfigParser parser;
+		if (config == nullptr || !parser.Initialize (config, "EventMgrConfig")){
+			LOG_WARNING ("No event manager config, events are dispatched uncoalesced");
+			LOG ("Event manager initialized");
+			return true;
+		}
+
+		// lanes first, deferred event types cannot be coalesced
+		XMLElement* lanes = parser.GetElement ("Lanes");
+		if (lanes != nullptr){
+			unsigned int budget = SIM_EVENT_DEFERRED_BUDGET;
+			lanes->QueryUnsignedAttribute ("DeferredBudget", &budget);
+			_deferredBudget = std::chrono::microseconds (budget);
+		}
+		XMLElement* element = lanes ? lanes->FirstChildElement ("Event") : nullptr;
+		while (element != nullptr){
+			EventType type = EventTypeByName (element->Attribute ("Type"));
+			const char* lane = element->Attribute ("Lane");
+			if (type == EventType::EVENT_INVALID || lane == nullptr){
+				LOG_ERROR ("Invalid lane entry in " << config);
+				return false;
+			}
+
+			if (!strcmp (lane, "Immediate")){
+				SetEventLane (type, EventLane::Immediate);
+			}
+			else if (!strcmp (lane, "SameFrame")){
+				SetEventLane (type, EventLane::SameFrame);
+			}
+			else if (!strcmp (lane, "Deferred")){
+				SetEventLane (type, EventLane::Deferred);
+			}
+			else {
+				LOG_ERROR ("Unknown event lane " << lane << " in " << config);
+				return false;
+			}
+			element = element->NextSiblingElement ("Event");
+		}
+
+		XMLElement* coalescing = parser.GetElement ("Coalescing");
+		element = coalescing ? coalescing->FirstChildElement ("Event") : nullptr;
+		while (element != nullptr){
+			EventType type = EventTypeByName (element->Attribute ("Type"));
+			const char* policy = element->Attribute ("Policy");
+			if (type == EventType::EVENT_INVALID || policy == nullptr){
+				LOG_ERROR ("Invalid coalescing entry in " << config);
+				return false;
+			}
+
+			if (!strcmp (policy, "KeepAll")){
+				SetCoalescePolicy (type, CoalescePolicy::KeepAll);
+			}
+			else if (!strcmp (policy, "KeepLatest")){
+				SetCoalescePolicy (type, CoalescePolicy::KeepLatest);
+			}
+			else if (!strcmp (policy, "Accumulate")){
+				SetCoalescePolicy (type, CoalescePolicy::Accumulate);
+			}
+			else {
+				LOG_ERROR ("Unknown coalescing policy " << policy << " in " << config);
+				return false;
+			}
+			element = element->NextSiblingElement ("Event");
+		}
+
+		XMLElement* recorder = parser.GetElement ("Recorder");
+		const char* mode = recorder ? recorder->Attribute ("Mode") : nullptr;
+		if (mode != nullptr && strcmp (mode, "Off")){
+			const char* file = recorder->Attribute ("File");
+			if (file == nullptr){
+				LOG_ERROR ("No event log file given in " << config);
+				return false;
+			}
+
+			if (!strcmp (mode, "Record")){
+				if (!StartRecording (file)){
+					return false;
+				}
+			}
+			else if (!strcmp (mode, "Replay")){
+				if (!StartReplay (file)){
+					return false;
+				}
+			}
+			else {
+				LOG_ERROR ("Unknown event recorder mode " << mode << " in " << config);
+				return false;
+			}
+		}
+
 		LOG ("Event manager initialized");
 		return true;
 	}
 
 	void EventManager::Cleanup ()
 	{
+		StopRecording ();
+		_replayer.reset ();
+		_frame = 0;
+
+		// drop undelivered events
+		Event events [SIM_EVENT_BATCH_SIZE];
+		while (_queue.PopN (events, SIM_EVENT_BATCH_SIZE) > 0){
+		}
+		while (_immediate.PopN (events, SIM_EVENT_BATCH_SIZE) > 0){
+		}
+		while (_deferred.PopN (events, SIM_EVENT_BATCH_SIZE) > 0){
+		}
+
+#		ifdef SIM_LOG_ENABLED
+		const char* names [NumLanes] = {"Immediate", "SameFrame", "Deferred"};
+#		endif
+		for (unsigned int l = 0; l < NumLanes; ++l){
+			LaneCounters& counters = _laneCounters [l];
+			if (counters._dispatched > 0 || counters._dropped > 0){
+				LOG (names [l] << " events: " << counters._dispatched << " dispatched (at most " << counters._peakDepth << " per frame), "
+						<< counters._dropped << " dropped, " << counters._carriedOver << " carried over");
+			}
+			counters._dropped = 0;
+			counters._peakDepth = counters._dispatched = counters._carriedOver = 0;
+		}
+		for (EventLane& lane : _lanes){
+			lane = EventLane::SameFrame;
+		}
+		_deferredBudget = std::chrono::microseconds (SIM_EVENT_DEFERRED_BUDGET);
+
+		if (_coalesced > 0){
+			LOG ("Event manager coalesced " << _coalesced << " events");
+		}
+		for (Coalescer& c : _coalescers){
+			c._policy = CoalescePolicy::KeepAll;
+			c._slots.reset ();
+			c._dirty.reset ();
+		}
+		_coalesced = 0;
+
+		{
+			// outboxes cached by threads still attached become stale
+			std::lock_guard <std::mutex> loki (_outboxMutex);
+			_outboxes.clear ();
+			_instance = ++instances;
+		}
 
+		for (unsigned int t = 0; t < NumEventTypes; ++t){
+			_listeners [t].clear ();
+			_wildcards [t].clear ();
+		}
 	}
 }
@@ -5,42 +5,280 @@
  * See LICENSE.txt included in this package
  *
  * @section DESCRIPTION
- * The EventManager system for the Chimera framework.
+ * The EventManager system for the Chimera framework. Events are queued
+ * from any thread and dispatched once per frame by Run (). Listeners are
+ * kept in a flat table indexed by event type and then by asset id, so a
+ * dispatch is a couple of array lookups. Any number of listeners may be
+ * registered per (event type, asset) pair, and a listener registered for
+ * SIM_EVENT_ALL_ASSETS receives the events of that type for every asset.
+ * Listeners must not be added or removed while Run () is dispatching on
+ * another thread.
+ * Events of a type with a coalescing policy (see EventMgrConfig.xml) are
+ * not queued one by one: they are merged per (event type, asset) into a
+ * slot that is dispatched once per frame, so listeners run once per asset
+ * per frame no matter how many events were raised for it.
+ * Worker threads of the task scheduler call AttachThread () to get their
+ * own outbox, so they do not contend on the shared queue. Other threads
+ * use the shared lock-free queue, which is dispatched after the outboxes.
+ * An event carries the graph task that raised it (SetProducer ()) and its
+ * number among the events of that task. Run () (the frame barrier)
+ * splices the outboxes into scratch memory of the frame arena and sorts
+ * them by asset id, event type, producer and number, so the dispatch
+ * order does not depend on which thread ran which task. Events raised
+ * outside of the graph tasks keep the order of their outboxes.
+ * Every event type belongs to a lane. All of the above describes the
+ * same-frame lane. Immediate events (collisions, haptics) have their own
+ * queue, which Run () dispatches first, ahead of the other lanes and
+ * without a time budget. Deferred events (bookkeeping) have their own
+ * queue too. It is dispatched last, within a per-frame time budget, and
+ * the events left over are carried over to the next frame. So a burst of
+ * low priority events never delays the higher lanes.
+ * Dispatched events can be recorded to a binary log, which is replayed in
+ * place of live input in a later session (see EventRecorder.h). An event
+ * is recorded as dispatched (after coalescing) with the frame (Run ()
+ * call since recording started) that dispatched it, and replay dispatches
+ * the events of each frame as recorded, bypassing the lanes.
  */
 #pragma once
 
-#include <map>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "Callback.h"
-#include "CircularQueue.h"
+#include "RingBuffer.h"
 #include "Events/Event.h"
+#include "Events/EventPayloads.h"
+#include "Events/EventRecorder.h"
+#include "Memory/FrameArena.h"
 
 namespace Sim {
 
-	typedef util::Callback <void (unsigned int)> EventListener;
+	typedef util::Callback <void (const Event&)> EventListener;
+	typedef unsigned int ListenerId;
+
+	// number of events that can be queued at once per lane (powers of two)
+	const unsigned int SIM_EVENT_QUEUE_SIZE = 1024;
+	const unsigned int SIM_EVENT_IMMEDIATE_QUEUE_SIZE = 256;
+	const unsigned int SIM_EVENT_DEFERRED_QUEUE_SIZE = 4096;
+	// default time budget of the deferred lane per frame, in microseconds
+	const unsigned int SIM_EVENT_DEFERRED_BUDGET = 1000;
+	// asset id used to listen to an event type for all assets
+	const unsigned int SIM_EVENT_ALL_ASSETS = 0xFFFFFFFF;
+	// upper limit on asset ids in the dispatch table
+	const unsigned int SIM_EVENT_MAX_ASSETS = 1024;
+	// number of events popped from the queue at a time
+	const unsigned int SIM_EVENT_BATCH_SIZE = 64;
+	// number of deferred events dispatched between checks of the time budget
+	const unsigned int SIM_EVENT_DEFERRED_BATCH_SIZE = 8;
+
+	enum class EventLane {
+		Immediate,		// dispatched first in the frame
+		SameFrame,		// dispatched within the frame (default)
+		Deferred,		// dispatched when the frame has time left
+		NumLanes
+	};
+
+	struct EventLaneStats {
+		size_t _depth = 0;			// events waiting in the lane's queue
+		size_t _peakDepth = 0;		// highest number of events dispatched in one frame
+		size_t _dispatched = 0;
+		size_t _dropped = 0;		// lane's queue was full
+		size_t _carriedOver = 0;	// deferred events pushed to the next frame by the time budget
+	};
+
+	// what to do with several events of one type for the same asset within a frame
+	enum class CoalescePolicy {
+		KeepAll,		// dispatch all of them
+		KeepLatest,		// dispatch the last one
+		Accumulate		// dispatch one, with the payloads merged (see below)
+	};
+	// Accumulated contacts become one equivalent contact: its normal and depth are
+	// the direction and length of the summed penetration (the sum of depth times
+	// normal), its position is the mean contact point, and its other asset is
+	// SIM_EVENT_ALL_ASSETS if the contacts were with several assets. Payloads that
+	// cannot be summed (intersections) keep the latest one. Event::_count always
+	// holds the number of events merged.
+	// coalescing applies to the immediate and same-frame lanes only
 
 	class EventManager {
 
 		private:
+			struct Listener {
+				ListenerId _id;
+				EventListener _callback;
+			};
+			typedef std::vector <Listener> ListenerList;
+
+			// pending coalesced event of one asset
+			struct Slot {
+				std::atomic_flag _lock = ATOMIC_FLAG_INIT;
+				bool _pending = false;
+				Event _event;
+			};
+			// coalescing state of one event type. A slot index is put in the
+			// dirty list when the slot becomes pending, so the list never
+			// holds more than SIM_EVENT_MAX_ASSETS entries
+			struct Coalescer {
+				CoalescePolicy _policy = CoalescePolicy::KeepAll;
+				std::unique_ptr <Slot []> _slots;
+				std::unique_ptr <RingBuffer <unsigned int, SIM_EVENT_MAX_ASSETS> > _dirty;
+			};
+
+			// events raised by one attached thread since the last frame barrier.
+			// The lock is only contended while Run () splices the outbox
+			struct Outbox {
+				std::atomic_flag _lock = ATOMIC_FLAG_INIT;
+				bool _attached = false;
+				std::vector <Event> _events;
+				char _pad [SIM_CACHE_LINE_SIZE];
+			};
+
+			struct LaneCounters {
+				std::atomic <size_t> _dropped {0};
+				size_t _peakDepth = 0;
+				size_t _dispatched = 0;
+				size_t _carriedOver = 0;
+			};
+
+			static const unsigned int NumEventTypes = static_cast <unsigned int> (EventType::EVENT_INVALID);
+			static const unsigned int NumLanes = static_cast <unsigned int> (EventLane::NumLanes);
+
+			// last listener id handed out
 			unsigned int _index = 0;
-			CircularQueue <Event, 64> _queue;
-			std::map <unsigned int, EventListener> _listeners;
+			RingBuffer <Event, SIM_EVENT_QUEUE_SIZE> _queue;
+			RingBuffer <Event, SIM_EVENT_IMMEDIATE_QUEUE_SIZE> _immediate;
+			RingBuffer <Event, SIM_EVENT_DEFERRED_QUEUE_SIZE> _deferred;
+
+			EventLane _lanes [NumEventTypes];
+			LaneCounters _laneCounters [NumLanes];
+			std::chrono::microseconds _deferredBudget {SIM_EVENT_DEFERRED_BUDGET};
+
+			// dispatch table: [event type][asset id] and wildcard listeners per event type
+			std::vector <ListenerList> _listeners [NumEventTypes];
+			ListenerList _wildcards [NumEventTypes];
+
+			Coalescer _coalescers [NumEventTypes];
+			// events merged into an already pending one (statistics)
+			std::atomic <size_t> _coalesced {0};
+
+			// identifies this manager in the outbox pointer cached by each thread
+			unsigned int _instance;
+			std::mutex _outboxMutex;
+			std::vector <std::unique_ptr <Outbox> > _outboxes;
+			// sorts the outbox events when the driver has no frame arena
+			FrameArena _scratch;
+
+			// number of the next Run ()
+			std::atomic <unsigned int> _frame {0};
+			std::unique_ptr <EventRecorder> _recorder;
+			// the frame recording started at, and the frame of the log the current Run () writes
+			unsigned int _recordStart = 0;
+			unsigned int _recordFrame = 0;
+			// live events are ignored while replaying
+			std::unique_ptr <EventReplayer> _replayer;
 
 		public:
-			EventManager () = default;
+			EventManager ();
 			~EventManager ();
 
 			EventManager (const EventManager&) = delete;
 			EventManager& operator = (const EventManager&) = delete;
 
 			bool Initialize (const char* config);
-			void Run ();
 			void Cleanup ();
 
-			bool AddListener (const EventListener&, EventType, unsigned int);
-			bool RemoveListener (const EventListener&, EventType, unsigned int);
+			// dispatches the events queued so far (events queued by listeners wait for the next call)
+			void Run ();
+
+			// returns the id used to remove the listener (zero on failure)
+			ListenerId AddListener (const EventListener&, EventType, unsigned int assetId = SIM_EVENT_ALL_ASSETS);
+			bool RemoveListener (ListenerId);
+
+			bool QueueEvent (const Event&);
+
+			// gives the calling thread its own outbox (for task scheduler workers)
+			void AttachThread ();
+			void DetachThread ();
+			// names the graph task the calling thread runs (zero for none), numbering its events from zero
+			static void SetProducer (unsigned short producer);
+
+			void SetCoalescePolicy (EventType, CoalescePolicy);
+			CoalescePolicy GetCoalescePolicy (EventType) const;
+			inline size_t CoalescedCount () const {return _coalesced.load (std::memory_order_relaxed);}
+
+			void SetEventLane (EventType, EventLane);
+			EventLane GetEventLane (EventType) const;
+			// zero disables the budget
+			void SetDeferredBudget (std::chrono::microseconds budget) {_deferredBudget = budget;}
+			EventLaneStats GetLaneStats (EventLane) const;
+
+			bool StartRecording (const char* file);
+			void StopRecording ();
+			bool StartReplay (const char* file);
+			inline bool IsReplaying () const {return _replayer != nullptr;}
+			inline bool IsReplayFinished () const {return _replayer && _replayer->IsFinished ();}
+			inline unsigned int GetFrame () const {return _frame.load (std::memory_order_relaxed);}
+
+		private:
+			bool Enqueue (const Event&);
+			bool Coalesce (Coalescer&, const Event&);
+			void Merge (CoalescePolicy, Event& pending, const Event&);
+			// adds 'contact' to 'sum', the 'count'th contact merged
+			static void AccumulateContact (ContactPayload& sum, const ContactPayload& contact, unsigned short count);
+			size_t DispatchCoalesced (Coalescer&);
+			Outbox* LocalOutbox () const;
+			size_t DispatchOutboxes ();
+			size_t DispatchCoalescedLane (EventLane);
+			void DispatchImmediate ();
+			void DispatchDeferred ();
+			bool PushLane (EventLane, const Event&);
+			void CountDispatched (EventLane, size_t);
+
+			// dispatches the events in the queue when called (at most 'limit'), returns the count
+			template <class Queue> size_t Drain (Queue& queue, size_t limit = SIZE_MAX)
+			{
+				size_t pending = queue.Size ();
+				if (pending > limit){
+					pending = limit;
+				}
+
+				size_t dispatched = 0;
+				Event events [SIM_EVENT_BATCH_SIZE];
+				while (pending > 0){
+					unsigned int n = queue.PopN (events, pending < SIM_EVENT_BATCH_SIZE ? pending : SIM_EVENT_BATCH_SIZE);
+					if (n == 0){
+						break;
+					}
+					for (unsigned int i = 0; i < n; ++i){
+						Dispatch (events [i]);
+					}
+					pending -= n;
+					dispatched += n;
+				}
+				return dispatched;
+			}
 
-			bool QueueEvent (Event&);
+			inline void Dispatch (const Event& e)
+			{
+				unsigned int type = static_cast <unsigned int> (e._eventId);
+				if (type >= NumEventTypes){
+					return;
+				}
+				if (_recorder){
+					_recorder->Record (e, _recordFrame);
+				}
+				for (const Listener& l : _wildcards [type]){
+					l._callback (e);
+				}
+				if (e._assetId < _listeners [type].size ()){
+					for (const Listener& l : _listeners [type][e._assetId]){
+						l._callback (e);
+					}
+				}
+			}
 	};
 }
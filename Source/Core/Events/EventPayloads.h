@@ -0,0 +1,47 @@
+/**
+ * @file EventPayloads.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Payloads carried inline by events. Each one is a plain struct of
+ * scalars (Vector is not trivially copyable) tagged with its PayloadType.
+ */
+#pragma once
+
+#include "Preprocess.h"
+#include "Events/Event.h"
+
+namespace Sim {
+
+	// contact between two assets (EVENT_COLLISION)
+	struct ContactPayload {
+		static const PayloadType Type = PayloadType::Contact;
+
+		Real _position [3];
+		Real _normal [3];
+		Real _depth;
+		unsigned int _otherAsset;
+	};
+
+	// tool-tissue intersection (EVENT_INTERSECTION)
+	struct IntersectionPayload {
+		static const PayloadType Type = PayloadType::Intersection;
+
+		Real _point [3];
+		Real _direction [3];
+		unsigned int _toolAsset;
+		unsigned int _face;
+	};
+
+	// bytes used by a payload type
+	inline size_t PayloadSize (PayloadType type)
+	{
+		switch (type){
+			case PayloadType::Contact: return sizeof (ContactPayload);
+			case PayloadType::Intersection: return sizeof (IntersectionPayload);
+			default: return 0;
+		}
+	}
+}
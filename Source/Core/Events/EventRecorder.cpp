@@ -0,0 +1,174 @@
+/**
+ * @file EventRecorder.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See EventRecorder.h.
+ */
+
+#include <chrono>
+#include <cstring>
+#include <iterator>
+
+#include "Log.h"
+#include "Events/EventPayloads.h"
+#include "Events/EventRecorder.h"
+
+using std::ios;
+
+namespace Sim {
+
+	namespace {
+		const char Magic [8] = {'S', 'I', 'M', 'E', 'V', 'L', 'O', 'G'};
+		const size_t RecordHeaderSize = 12;
+		// records popped by the writer thread at a time
+		const unsigned int WriteBatchSize = 256;
+	}
+
+	EventRecorder::~EventRecorder () {Stop ();}
+
+	bool EventRecorder::Start (const char* file)
+	{
+		if (_writer.joinable ()){
+			LOG_ERROR ("Event recorder already running");
+			return false;
+		}
+
+		_file.open (file, ios::out | ios::binary | ios::trunc);
+		if (!_file.is_open ()){
+			LOG_ERROR ("Could not open event log " << file);
+			return false;
+		}
+
+		EventLogHeader header;
+		memcpy (header._magic, Magic, sizeof (Magic));
+		header._version = SIM_EVENT_LOG_VERSION;
+		header._payloadSize = SIM_EVENT_PAYLOAD_SIZE;
+		_file.write (reinterpret_cast <const char*> (&header), sizeof (header));
+
+		_queue.reset (new RingBuffer <RecordedEvent, SIM_EVENT_RECORDER_QUEUE_SIZE>);
+		_recorded = 0;
+		_bytes = sizeof (header);
+		_running = true;
+		_writer = std::thread (&EventRecorder::Write, this);
+
+		LOG ("Recording events to " << file);
+		return true;
+	}
+
+	void EventRecorder::Stop ()
+	{
+		// the writer may have been stopped by an overflow already
+		if (!_writer.joinable ()){
+			return;
+		}
+
+		_running = false;
+		_writer.join ();
+		_file.close ();
+
+		LOG ("Event recorder wrote " << _recorded << " events (" << _bytes << " bytes)");
+	}
+
+	void EventRecorder::Overflow (unsigned int frame)
+	{
+		// the writer drains what is buffered and exits, Stop () joins it
+		_running = false;
+		LOG_ERROR ("Event recorder buffer full at frame " << frame << ", recording stopped: the log misses the events from there on");
+	}
+
+	void EventRecorder::Write ()
+	{
+		RecordedEvent records [WriteBatchSize];
+		std::vector <char> buffer (WriteBatchSize*(RecordHeaderSize + SIM_EVENT_PAYLOAD_SIZE));
+
+		// after Stop () the queue is drained before the thread exits
+		while (true){
+			bool running = _running.load (std::memory_order_acquire);
+			unsigned int n = _queue->PopN (records, WriteBatchSize);
+			if (n == 0){
+				if (!running){
+					break;
+				}
+				std::this_thread::sleep_for (std::chrono::milliseconds (1));
+				continue;
+			}
+
+			char* out = buffer.data ();
+			for (unsigned int i = 0; i < n; ++i){
+				const Event& e = records [i]._event;
+				unsigned char type = static_cast <unsigned char> (e._eventId);
+				unsigned char payloadType = static_cast <unsigned char> (e._payloadType);
+				size_t payloadSize = PayloadSize (e._payloadType);
+
+				memcpy (out, &records [i]._frame, 4);
+				memcpy (out + 4, &e._assetId, 4);
+				out [8] = static_cast <char> (type);
+				out [9] = static_cast <char> (payloadType);
+				memcpy (out + 10, &e._count, 2);
+				memcpy (out + RecordHeaderSize, e.PayloadData (), payloadSize);
+				out += RecordHeaderSize + payloadSize;
+			}
+			_file.write (buffer.data (), out - buffer.data ());
+			_recorded += n;
+			_bytes += out - buffer.data ();
+		}
+		_file.flush ();
+	}
+
+	bool EventReplayer::Open (const char* file)
+	{
+		std::ifstream log (file, ios::in | ios::binary);
+		if (!log.is_open ()){
+			LOG_ERROR ("Could not open event log " << file);
+			return false;
+		}
+		std::vector <char> data ((std::istreambuf_iterator <char> (log)), std::istreambuf_iterator <char> ());
+
+		EventLogHeader header;
+		if (data.size () < sizeof (header)){
+			LOG_ERROR (file << " is not an event log");
+			return false;
+		}
+		memcpy (&header, data.data (), sizeof (header));
+		if (memcmp (header._magic, Magic, sizeof (Magic)) || header._version != SIM_EVENT_LOG_VERSION){
+			LOG_ERROR (file << " is not an event log of version " << SIM_EVENT_LOG_VERSION);
+			return false;
+		}
+		if (header._payloadSize != SIM_EVENT_PAYLOAD_SIZE){
+			LOG_ERROR (file << " was recorded with a different precision");
+			return false;
+		}
+
+		_events.clear ();
+		_next = 0;
+		size_t offset = sizeof (header);
+		while (offset + RecordHeaderSize <= data.size ()){
+			const char* in = data.data () + offset;
+			RecordedEvent r;
+			unsigned char type = static_cast <unsigned char> (in [8]);
+			unsigned char payloadType = static_cast <unsigned char> (in [9]);
+
+			memcpy (&r._frame, in, 4);
+			memcpy (&r._event._assetId, in + 4, 4);
+			r._event._eventId = static_cast <EventType> (type);
+			memcpy (&r._event._count, in + 10, 2);
+
+			size_t payloadSize = PayloadSize (static_cast <PayloadType> (payloadType));
+			if (offset + RecordHeaderSize + payloadSize > data.size ()){
+				break;
+			}
+			r._event.SetPayloadData (static_cast <PayloadType> (payloadType), in + RecordHeaderSize, payloadSize);
+			_events.push_back (r);
+			offset += RecordHeaderSize + payloadSize;
+		}
+		if (offset != data.size ()){
+			LOG_WARNING ("Event log " << file << " is truncated");
+		}
+
+		LOG ("Replaying " << _events.size () << " events from " << file);
+		return true;
+	}
+}
@@ -0,0 +1,116 @@
+/**
+ * @file EventRecorder.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Binary event logs. The EventRecorder is handed every dispatched event
+ * together with its frame number. It buffers them in a lock-free queue
+ * that a background thread drains to the log file, so recording costs the
+ * dispatching thread one push, and the records are in frame order. A full
+ * buffer (the writer cannot keep up) stops the recording with an error
+ * rather than blocking or leaving holes in the log, which then ends at
+ * the last event buffered.
+ * Each record is a 12 byte header (frame, asset id, event type, payload
+ * type, coalesced count) followed by the payload bytes, if there are any.
+ * The EventReplayer loads a log and hands back its events frame by frame.
+ */
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "RingBuffer.h"
+#include "Events/Event.h"
+
+namespace Sim {
+
+	// events buffered for the writer thread (power of two)
+	const unsigned int SIM_EVENT_RECORDER_QUEUE_SIZE = 8192;
+	const unsigned int SIM_EVENT_LOG_VERSION = 2;
+
+	struct EventLogHeader {
+		char _magic [8];
+		unsigned int _version;
+		unsigned int _payloadSize;
+	};
+
+	// an event and the frame whose Run () dispatched it
+	struct RecordedEvent {
+		unsigned int _frame;
+		Event _event;
+	};
+
+	class EventRecorder {
+
+		private:
+			std::ofstream _file;
+			std::unique_ptr <RingBuffer <RecordedEvent, SIM_EVENT_RECORDER_QUEUE_SIZE> > _queue;
+			std::thread _writer;
+			std::atomic <bool> _running {false};
+
+			// owned by the writer thread while recording
+			size_t _recorded = 0;
+			size_t _bytes = 0;
+
+		public:
+			EventRecorder () = default;
+			~EventRecorder ();
+
+			EventRecorder (const EventRecorder&) = delete;
+			EventRecorder& operator = (const EventRecorder&) = delete;
+
+			bool Start (const char* file);
+			// writes the buffered events and closes the log
+			void Stop ();
+
+			// called from the dispatching thread, never blocks
+			inline void Record (const Event& e, unsigned int frame)
+			{
+				if (_running.load (std::memory_order_relaxed) && !_queue->TryPush (RecordedEvent {frame, e})){
+					Overflow (frame);
+				}
+			}
+
+			// false once stopped, or when the buffer overflowed
+			inline bool IsRecording () const {return _running.load (std::memory_order_relaxed);}
+
+		private:
+			void Write ();
+			void Overflow (unsigned int frame);
+	};
+
+	class EventReplayer {
+
+		private:
+			std::vector <RecordedEvent> _events;
+			size_t _next = 0;
+
+		public:
+			EventReplayer () = default;
+			~EventReplayer () = default;
+
+			EventReplayer (const EventReplayer&) = delete;
+			EventReplayer& operator = (const EventReplayer&) = delete;
+
+			bool Open (const char* file);
+
+			// next event recorded for the given frame or an earlier one, false if there is none
+			// (the records are in frame order)
+			inline bool Next (unsigned int frame, Event& e)
+			{
+				if (_next == _events.size () || _events [_next]._frame > frame){
+					return false;
+				}
+				e = _events [_next++]._event;
+				return true;
+			}
+
+			inline bool IsFinished () const {return _next == _events.size ();}
+			inline size_t Size () const {return _events.size ();}
+	};
+}
@@ -0,0 +1,69 @@
+/**
+ * @file AllocationCounter.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See AllocationCounter.h.
+ */
+
+#include <cstdlib>
+#include <new>
+
+#include "Memory/AllocationCounter.h"
+
+namespace Sim {
+
+	namespace {
+		// counter of the innermost scope of the calling thread
+		thread_local AllocationCounter* current = nullptr;
+	}
+
+	void AllocationCounter::Count (size_t bytes)
+	{
+		if (current != nullptr){
+			current->_count.fetch_add (1, std::memory_order_relaxed);
+		}
+	}
+
+#	ifndef NDEBUG
+	AllocationScope::AllocationScope (AllocationCounter& counter): _previous (current)
+	{
+		current = &counter;
+	}
+
+	AllocationScope::AllocationScope (): _previous (current)
+	{
+		current = nullptr;
+	}
+
+	AllocationScope::~AllocationScope ()
+	{
+		current = _previous;
+	}
+#	endif
+}
+
+#ifndef NDEBUG
+// the other forms of operator new and delete end up in these
+void* operator new (size_t bytes)
+{
+	Sim::AllocationCounter::Count (bytes);
+	void* memory = malloc (bytes > 0 ? bytes : 1);
+	if (memory == nullptr){
+		throw std::bad_alloc ();
+	}
+	return memory;
+}
+
+void operator delete (void* memory) noexcept
+{
+	free (memory);
+}
+
+void operator delete (void* memory, size_t) noexcept
+{
+	free (memory);
+}
+#endif
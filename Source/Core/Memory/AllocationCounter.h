@@ -0,0 +1,65 @@
+/**
+ * @file AllocationCounter.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Counts the heap allocations (global operator new) made by chosen code,
+ * to check that steady-state frames do not allocate. A thread counts its
+ * allocations into a counter while an AllocationScope on that counter is
+ * alive, so the frame threads can count into one counter while the lanes
+ * count into their own. Debug builds only: without NDEBUG the global
+ * operator new is replaced by a counting one; with NDEBUG scopes do
+ * nothing and counters stay at zero. A scope without a counter stops the
+ * counting, for work that runs inside counted code but is not part of it.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace Sim {
+
+	class AllocationCounter {
+
+			friend class AllocationScope;
+
+		private:
+			std::atomic <size_t> _count {0};
+
+		public:
+			AllocationCounter () = default;
+			~AllocationCounter () = default;
+
+			AllocationCounter (const AllocationCounter&) = delete;
+			AllocationCounter& operator = (const AllocationCounter&) = delete;
+
+			size_t Count () const {return _count.load (std::memory_order_relaxed);}
+			void Reset () {_count.store (0, std::memory_order_relaxed);}
+
+			// counts an allocation of the calling thread, if it is in a scope
+			static void Count (size_t bytes);
+	};
+
+	class AllocationScope {
+
+		private:
+			// scopes nest, the innermost counts
+			AllocationCounter* _previous = nullptr;
+
+		public:
+#			ifndef NDEBUG
+			explicit AllocationScope (AllocationCounter& counter);
+			AllocationScope ();
+			~AllocationScope ();
+#			else
+			explicit AllocationScope (AllocationCounter&) {}
+			AllocationScope () {}
+			~AllocationScope () = default;
+#			endif
+
+			AllocationScope (const AllocationScope&) = delete;
+			AllocationScope& operator = (const AllocationScope&) = delete;
+	};
+}
@@ -0,0 +1,176 @@
+/**
+ * @file ConcurrentMemoryPool.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See ConcurrentMemoryPool.h.
+ */
+#include <cstdlib>
+#include <atomic>
+#include <thread>
+
+#include "Preprocess.h"
+#include "Log.h"
+#include "Memory/ConcurrentMemoryPool.h"
+
+namespace Sim {
+
+	ConcurrentMemoryPool::ConcurrentMemoryPool ()
+	{
+		for (unsigned int i = 0; i < MaxBlocks; ++i){
+			_blocks [i].store (nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	ConcurrentMemoryPool::~ConcurrentMemoryPool ()
+	{
+		Cleanup ();
+	}
+
+	// function to initialize the pool with specified page size and number of pages in the first block
+	bool ConcurrentMemoryPool::Initialize (unsigned int pageSize, unsigned int numPages)
+	{
+		if (_numBlocks.load (std::memory_order_relaxed) > 0){
+			LOG_WARNING ("Current memory pool is not empty. All allocated memory will be destroyed");
+			Cleanup ();
+		}
+		if (numPages == 0){
+			LOG_ERROR ("Cannot initialize memory pool with zero pages");
+			return false;
+		}
+
+		// a free page must be able to hold the link to the next one
+		_pageSize = pageSize;
+		_stride = pageSize < sizeof (uint32_t) ? sizeof (uint32_t) : pageSize;
+		_stride = (_stride + sizeof (void*) - 1) & ~(unsigned int)(sizeof (void*) - 1);
+		_numPages = numPages;
+
+		return GrowArray ();
+	}
+
+	// completely destroy the memory pool
+	void ConcurrentMemoryPool::Cleanup ()
+	{
+		unsigned int count = _numBlocks.load (std::memory_order_acquire);
+		for (unsigned int i = 0; i < count; ++i){
+			free (_blocks [i].load (std::memory_order_relaxed));
+			_blocks [i].store (nullptr, std::memory_order_relaxed);
+		}
+		_numBlocks.store (0, std::memory_order_release);
+		_head.store (NullIndex, std::memory_order_release);
+	}
+
+	// pops the head of the free list
+	void* ConcurrentMemoryPool::Allocate ()
+	{
+		uint64_t head = _head.load (std::memory_order_acquire);
+		for (;;){
+			uint32_t index = Index (head);
+
+			// out of pages: add a block (or wait for another thread to add one) and retry
+			if (index == NullIndex){
+				if (!_allowResize || !GrowArray ()){
+					return nullptr;
+				}
+				head = _head.load (std::memory_order_acquire);
+				continue;
+			}
+
+			// the link may be stale if the page was taken meanwhile, in which case the tag makes the CAS fail
+			uint32_t next = Link (index)->load (std::memory_order_relaxed);
+			if (_head.compare_exchange_weak (head, Pack (next, head), std::memory_order_acquire, std::memory_order_acquire)){
+				return PageAddress (index);
+			}
+		}
+	}
+
+	// pushes page on to the free list
+	void ConcurrentMemoryPool::Free (void* memoryPointer)
+	{
+		if (memoryPointer == nullptr){
+			return;
+		}
+		uint32_t index = PageIndex (memoryPointer);
+		if (index == NullIndex){
+			return;
+		}
+
+		uint64_t head = _head.load (std::memory_order_relaxed);
+		do {
+			Link (index)->store (Index (head), std::memory_order_relaxed);
+		} while (!_head.compare_exchange_weak (head, Pack (index, head), std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	// adds the next geometrically sized block and pushes all its pages with a single CAS
+	bool ConcurrentMemoryPool::GrowArray ()
+	{
+		bool expected = false;
+		if (!_growing.compare_exchange_strong (expected, true, std::memory_order_acquire)){
+			// another thread is growing the pool: wait for it to publish and let the caller retry
+			while (_growing.load (std::memory_order_acquire)){
+				std::this_thread::yield ();
+			}
+			return true;
+		}
+
+		unsigned int block = _numBlocks.load (std::memory_order_relaxed);
+		if (block >= MaxBlocks || BlockStart (block + 1) >= NullIndex){
+			LOG_ERROR ("Concurrent memory pool reached its maximum page count");
+			_growing.store (false, std::memory_order_release);
+			return false;
+		}
+
+		uint64_t count = uint64_t (_numPages) << block;
+		unsigned char* memory = (unsigned char*) malloc (count*_stride);
+		if (memory == nullptr){
+			LOG_ERROR ("Could not allocate memory block of " << count << " pages");
+			_growing.store (false, std::memory_order_release);
+			return false;
+		}
+
+		// link the new pages privately before anyone can see them
+		uint32_t first = static_cast <uint32_t> (BlockStart (block));
+		for (uint64_t i = 0; i < count - 1; ++i){
+			reinterpret_cast <std::atomic <uint32_t>*> (memory + i*_stride)->store (first + i + 1, std::memory_order_relaxed);
+		}
+
+		// publish the block so that its page indices can be translated
+		_blocks [block].store (memory, std::memory_order_release);
+		_numBlocks.store (block + 1, std::memory_order_release);
+
+		// splice the whole chain in front of the current free list
+		std::atomic <uint32_t>* tail = reinterpret_cast <std::atomic <uint32_t>*> (memory + (count - 1)*_stride);
+		uint64_t head = _head.load (std::memory_order_relaxed);
+		do {
+			tail->store (Index (head), std::memory_order_relaxed);
+		} while (!_head.compare_exchange_weak (head, Pack (first, head), std::memory_order_release, std::memory_order_relaxed));
+
+		_growing.store (false, std::memory_order_release);
+		return true;
+	}
+
+	unsigned char* ConcurrentMemoryPool::PageAddress (uint32_t index) const
+	{
+		// block k starts at page N*(2^k - 1)
+		uint32_t scaled = index/_numPages + 1;
+		unsigned int block = 31 - __builtin_clz (scaled);
+		uint64_t offset = index - BlockStart (block);
+		return _blocks [block].load (std::memory_order_acquire) + offset*_stride;
+	}
+
+	uint32_t ConcurrentMemoryPool::PageIndex (void* memoryPointer) const
+	{
+		unsigned char* page = static_cast <unsigned char*> (memoryPointer);
+		unsigned int count = _numBlocks.load (std::memory_order_acquire);
+		for (unsigned int i = 0; i < count; ++i){
+			unsigned char* start = _blocks [i].load (std::memory_order_acquire);
+			if (page >= start && page < start + (uint64_t (_numPages) << i)*_stride){
+				return static_cast <uint32_t> (BlockStart (i) + (page - start)/_stride);
+			}
+		}
+		LOG_ERROR ("Page does not belong to this memory pool");
+		return NullIndex;
+	}
+}
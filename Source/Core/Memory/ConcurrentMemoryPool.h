@@ -0,0 +1,84 @@
+/**
+ * @file ConcurrentMemoryPool.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Lock-free counterpart of the MemoryPool for small fixed-size objects.
+ * The free list is a Treiber stack whose head packs a 32-bit page index
+ * and a 32-bit generation tag into one 64-bit word, so every push/pop is
+ * a single CAS and a page that is popped and pushed back in between can
+ * not be mistaken for the old head (ABA). While a page is free, its first
+ * four bytes hold the index of the next free page; no header is kept.
+ * Blocks grow geometrically (block k holds N*2^k pages) into a fixed
+ * table, so a page index maps to its block with a single bit scan. New
+ * blocks are linked privately by one growing thread and published with
+ * a single CAS on the head; allocators are never stopped.
+ * Initialize () and Cleanup () must not race with Allocate () / Free ().
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace Sim {
+
+	class ConcurrentMemoryPool {
+
+	private:
+		static const unsigned int MaxBlocks = 32;
+		static const uint32_t NullIndex = 0xFFFFFFFF;
+
+		// generation-tagged head of the free list (tag << 32 | page index)
+		alignas (64) std::atomic <uint64_t> _head {NullIndex};
+
+		// set while a thread is allocating and publishing a new block
+		alignas (64) std::atomic <bool> _growing {false};
+		std::atomic <unsigned int> _numBlocks {0};
+		std::atomic <unsigned char*> _blocks [MaxBlocks];
+
+		// distance between consecutive pages in bytes
+		unsigned int _stride = 0;
+		// size of single page in bytes
+		unsigned int _pageSize = 0;
+		// number of pages in the first block
+		unsigned int _numPages = 0;
+		// true if we add blocks when the pool fills up
+		bool _allowResize = false;
+
+	public:
+		ConcurrentMemoryPool ();
+		~ConcurrentMemoryPool ();
+
+		ConcurrentMemoryPool (const ConcurrentMemoryPool&) = delete;
+		ConcurrentMemoryPool& operator = (const ConcurrentMemoryPool&) = delete;
+
+		bool Initialize (unsigned int pageSize, unsigned int numPages);
+		void Cleanup ();
+
+		// lock-free page retrieval and release (safe from any number of threads)
+		void* Allocate ();
+		void Free (void* memoryPointer);
+
+		unsigned int PageSize () const {return _pageSize;}
+		void AllowResize (bool flag) {_allowResize = flag;}
+
+	private:
+		bool GrowArray ();
+
+		// page index <-> address translation
+		unsigned char* PageAddress (uint32_t index) const;
+		uint32_t PageIndex (void* memoryPointer) const;
+		uint64_t BlockStart (unsigned int block) const {return uint64_t (_numPages)*((uint64_t (1) << block) - 1);}
+
+		// the free-list link stored in the first bytes of a free page
+		std::atomic <uint32_t>* Link (uint32_t index) const
+		{
+			return reinterpret_cast <std::atomic <uint32_t>*> (PageAddress (index));
+		}
+
+		static uint32_t Index (uint64_t head) {return static_cast <uint32_t> (head);}
+		static uint64_t Pack (uint32_t index, uint64_t oldHead) {return ((oldHead >> 32) + 1) << 32 | index;}
+	};
+}
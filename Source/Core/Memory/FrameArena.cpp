@@ -0,0 +1,242 @@
+/**
+ * @file FrameArena.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See FrameArena.h.
+ */
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "Preprocess.h"
+#include "Log.h"
+#include "Memory/FrameArena.h"
+
+namespace Sim {
+
+	namespace {
+
+		// chunk data starts on a cache line
+		const size_t SIM_ARENA_CHUNK_HEADER = SIM_CACHE_LINE_SIZE;
+
+		std::atomic <unsigned int> s_arenaIds {0};
+
+		// the sub-arena of the last frame arena used by this thread
+		thread_local unsigned int t_arenaId = 0;
+		thread_local void* t_subArena = nullptr;
+
+		inline unsigned char* AlignUp (unsigned char* p, size_t alignment)
+		{
+			return reinterpret_cast <unsigned char*> ((reinterpret_cast <uintptr_t> (p) + alignment - 1) & ~(uintptr_t (alignment) - 1));
+		}
+	}
+
+	bool FrameArena::Initialize (size_t bytesPerThread)
+	{
+		if (_chunkSize != 0){
+			LOG_WARNING ("Current frame arena is not empty. All allocated memory will be destroyed");
+			Cleanup ();
+		}
+		if (bytesPerThread == 0){
+			LOG_ERROR ("Cannot initialize frame arena with zero bytes");
+			return false;
+		}
+		_chunkSize = bytesPerThread;
+		_id = ++s_arenaIds;
+		_frame = 0;
+		return true;
+	}
+
+	void FrameArena::Cleanup ()
+	{
+		unsigned int count = _numArenas.load (std::memory_order_acquire);
+		for (unsigned int i = 0; i < count; ++i){
+			_arenas [i].Release ();
+			_arenas [i]._owner = std::thread::id ();
+			_arenas [i]._highWater = 0;
+		}
+		_numArenas.store (0, std::memory_order_release);
+		_chunkSize = 0;
+		_id = 0;
+	}
+
+	void* FrameArena::Allocate (size_t bytes, size_t alignment)
+	{
+		SubArena* arena = LocalArena ();
+		if (arena == nullptr){
+			return nullptr;
+		}
+		return arena->Allocate (bytes, alignment, _chunkSize);
+	}
+
+	bool FrameArena::Extend (void* memory, size_t oldBytes, size_t newBytes)
+	{
+		SubArena* arena = LocalArena ();
+		if (arena == nullptr){
+			return false;
+		}
+		return arena->Extend (memory, oldBytes, newBytes);
+	}
+
+	void FrameArena::Reset ()
+	{
+		unsigned int count = _numArenas.load (std::memory_order_acquire);
+		for (unsigned int i = 0; i < count; ++i){
+			_arenas [i].Reset (_chunkSize);
+		}
+		++_frame;
+	}
+
+	size_t FrameArena::Used () const
+	{
+		size_t used = 0;
+		unsigned int count = _numArenas.load (std::memory_order_acquire);
+		for (unsigned int i = 0; i < count; ++i){
+			used += _arenas [i]._used;
+		}
+		return used;
+	}
+
+	size_t FrameArena::HighWaterMark () const
+	{
+		size_t mark = 0;
+		unsigned int count = _numArenas.load (std::memory_order_acquire);
+		for (unsigned int i = 0; i < count; ++i){
+			mark += _arenas [i]._used > _arenas [i]._highWater ? _arenas [i]._used : _arenas [i]._highWater;
+		}
+		return mark;
+	}
+
+	void FrameArena::Report () const
+	{
+#		ifdef SIM_LOG_ENABLED
+		unsigned int count = _numArenas.load (std::memory_order_acquire);
+		for (unsigned int i = 0; i < count; ++i){
+			const SubArena& a = _arenas [i];
+			LOG ("Frame arena thread " << i << ": high-water mark " << (a._used > a._highWater ? a._used : a._highWater)
+					<< " bytes, reserved " << a._chunkBytes << " bytes");
+		}
+		LOG ("Frame arena: " << count << " threads, high-water mark " << HighWaterMark () << " bytes over " << _frame << " frames");
+#		endif
+	}
+
+	// finds (or assigns) the sub-arena of the calling thread
+	FrameArena::SubArena* FrameArena::LocalArena ()
+	{
+		if (t_arenaId == _id && t_subArena != nullptr){
+			return static_cast <SubArena*> (t_subArena);
+		}
+		if (_chunkSize == 0){
+			LOG_ERROR ("Frame arena used before initialization");
+			return nullptr;
+		}
+
+		std::lock_guard <std::mutex> loki (_mutex);
+
+		std::thread::id self = std::this_thread::get_id ();
+		unsigned int count = _numArenas.load (std::memory_order_relaxed);
+		SubArena* arena = nullptr;
+		for (unsigned int i = 0; i < count && arena == nullptr; ++i){
+			if (_arenas [i]._owner == self){
+				arena = &_arenas [i];
+			}
+		}
+		if (arena == nullptr){
+			if (count == SIM_ARENA_MAX_THREADS){
+				LOG_ERROR ("More than " << SIM_ARENA_MAX_THREADS << " threads allocating from frame arena");
+				return nullptr;
+			}
+			arena = &_arenas [count];
+			arena->_owner = self;
+			_numArenas.store (count + 1, std::memory_order_release);
+		}
+
+		t_arenaId = _id;
+		t_subArena = arena;
+		return arena;
+	}
+
+	void* FrameArena::SubArena::Allocate (size_t bytes, size_t alignment, size_t chunkSize)
+	{
+		unsigned char* p = AlignUp (_current, alignment);
+		if (_current == nullptr || p + bytes > _end){
+			// overflow: borrow a chunk at least as large as everything reserved so far
+			size_t size = chunkSize > _chunkBytes ? chunkSize : _chunkBytes;
+			if (size < bytes + alignment){
+				size = bytes + alignment;
+			}
+			if (!AddChunk (size)){
+				return nullptr;
+			}
+			p = AlignUp (_current, alignment);
+		}
+		_used += (p + bytes) - _current;
+		_current = p + bytes;
+		return p;
+	}
+
+	bool FrameArena::SubArena::Extend (void* memory, size_t oldBytes, size_t newBytes)
+	{
+		unsigned char* p = static_cast <unsigned char*> (memory);
+		if (p + oldBytes != _current || p + newBytes > _end){
+			return false;
+		}
+		_used += newBytes - oldBytes;
+		_current = p + newBytes;
+		return true;
+	}
+
+	void FrameArena::SubArena::Reset (size_t chunkSize)
+	{
+		if (_used > _highWater){
+			_highWater = _used;
+		}
+
+		// several chunks were needed: replace them by one that fits the high-water mark
+		if (_chunks != nullptr && _chunks->_next != nullptr){
+			size_t size = _highWater + SIM_CACHE_LINE_SIZE;
+			Release ();
+			AddChunk (size > chunkSize ? size : chunkSize);
+		}
+		else if (_chunks != nullptr){
+			_current = reinterpret_cast <unsigned char*> (_chunks) + SIM_ARENA_CHUNK_HEADER;
+		}
+		_used = 0;
+	}
+
+	void FrameArena::SubArena::Release ()
+	{
+		while (_chunks != nullptr){
+			Chunk* next = _chunks->_next;
+			free (_chunks);
+			_chunks = next;
+		}
+		_current = nullptr;
+		_end = nullptr;
+		_used = 0;
+		_chunkBytes = 0;
+	}
+
+	bool FrameArena::SubArena::AddChunk (size_t bytes)
+	{
+		void* memory = nullptr;
+		if (posix_memalign (&memory, SIM_CACHE_LINE_SIZE, SIM_ARENA_CHUNK_HEADER + bytes) != 0){
+			LOG_ERROR ("Could not allocate frame arena chunk of " << bytes << " bytes");
+			return false;
+		}
+		Chunk* chunk = static_cast <Chunk*> (memory);
+		chunk->_next = _chunks;
+		chunk->_size = bytes;
+		_chunks = chunk;
+
+		_current = static_cast <unsigned char*> (memory) + SIM_ARENA_CHUNK_HEADER;
+		_end = _current + bytes;
+		_chunkBytes += bytes;
+		return true;
+	}
+}
@@ -0,0 +1,214 @@
+/**
+ * @file FrameArena.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Linear (bump-pointer) allocator for data that lives for a single
+ * simulation step - collision pairs, contact points, event payloads and
+ * scratch buffers. Allocation is a pointer increment and everything is
+ * released at once when the driver calls Reset () at the end of a step.
+ * Every thread gets its own sub-arena on first use, so workers never
+ * contend. A sub-arena that overflows borrows an extra chunk from the
+ * heap; on Reset () its chunks are merged into one chunk as large as the
+ * high-water mark, so a steady-state step makes no heap allocation.
+ * Nothing allocated from the arena is ever destructed: only trivially
+ * destructible types may be placed in it.
+ * Reset () and Cleanup () must only be called while no other thread is
+ * allocating (i.e. at the frame barrier).
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "Log.h"
+
+namespace Sim {
+
+	// maximum number of threads that can allocate from one arena
+	const unsigned int SIM_ARENA_MAX_THREADS = 64;
+
+	class FrameArena {
+
+	private:
+		// bump allocator used by a single thread
+		class SubArena {
+
+			friend class FrameArena;
+
+		protected:
+			struct Chunk {
+				Chunk* _next;
+				size_t _size;
+			};
+
+			std::thread::id _owner;
+			Chunk* _chunks = nullptr; // newest chunk first
+			unsigned char* _current = nullptr;
+			unsigned char* _end = nullptr;
+			size_t _used = 0; // bytes requested this frame
+			size_t _chunkBytes = 0; // bytes in all chunks
+			size_t _highWater = 0;
+
+		public:
+			SubArena () = default;
+			~SubArena () {Release ();}
+
+			void* Allocate (size_t bytes, size_t alignment, size_t chunkSize);
+			bool Extend (void* memory, size_t oldBytes, size_t newBytes);
+			void Reset (size_t chunkSize);
+			void Release ();
+
+		protected:
+			bool AddChunk (size_t bytes);
+		};
+
+		SubArena _arenas [SIM_ARENA_MAX_THREADS];
+		std::atomic <unsigned int> _numArenas {0};
+		std::mutex _mutex; // guards sub-arena assignment only
+
+		// size of the first chunk of every sub-arena
+		size_t _chunkSize = 0;
+		// unique id used by threads to cache their sub-arena
+		unsigned int _id = 0;
+		unsigned long _frame = 0;
+
+	public:
+		FrameArena () = default;
+		~FrameArena () {Cleanup ();}
+
+		FrameArena (const FrameArena&) = delete;
+		FrameArena& operator = (const FrameArena&) = delete;
+
+		bool Initialize (size_t bytesPerThread);
+		void Cleanup ();
+
+		// returns uninitialized memory that stays valid until the next Reset ()
+		void* Allocate (size_t bytes, size_t alignment = alignof (std::max_align_t));
+
+		// returns 'count' value-initialized objects of type T
+		template <class T> T* Allocate (size_t count = 1)
+		{
+			static_assert (std::is_trivially_destructible <T>::value, "Frame arena objects are never destructed");
+			T* memory = static_cast <T*> (Allocate (count*sizeof (T), alignof (T)));
+			if (memory != nullptr){
+				for (size_t i = 0; i < count; ++i){
+					new (memory + i) T ();
+				}
+			}
+			return memory;
+		}
+
+		/**
+		 * Grows the most recent allocation of the calling thread in place. Returns
+		 * false (and leaves the allocation untouched) if 'memory' was not the last
+		 * allocation or the current chunk has no room.
+		 */
+		bool Extend (void* memory, size_t oldBytes, size_t newBytes);
+
+		// releases everything allocated during the frame (frame barrier only)
+		void Reset ();
+
+		unsigned long Frame () const {return _frame;}
+		size_t Used () const;
+		size_t HighWaterMark () const;
+		void Report () const;
+
+	private:
+		SubArena* LocalArena ();
+	};
+
+	/**
+	 * Growable array that lives in a FrameArena. It is valid until the arena is
+	 * reset and never runs destructors. Growing first tries to extend the buffer
+	 * in place, otherwise the contents move to a buffer twice the size (the old
+	 * one is reclaimed on Reset ()).
+	 */
+	template <class T> class ArenaVector {
+
+		static_assert (std::is_trivially_destructible <T>::value, "Frame arena objects are never destructed");
+
+	private:
+		FrameArena* _arena = nullptr;
+		T* _data = nullptr;
+		size_t _count = 0;
+		size_t _capacity = 0;
+
+	public:
+		ArenaVector (FrameArena& arena, size_t capacity = 0) : _arena (&arena)
+		{
+			if (capacity > 0){
+				Reserve (capacity);
+			}
+		}
+		~ArenaVector () = default;
+
+		ArenaVector (const ArenaVector&) = delete;
+		ArenaVector& operator = (const ArenaVector&) = delete;
+
+		T& operator [] (size_t index) {return _data [index];}
+		const T& operator [] (size_t index) const {return _data [index];}
+
+		size_t size () const {return _count;}
+		size_t capacity () const {return _capacity;}
+		bool empty () const {return _count == 0;}
+
+		T* data () {return _data;}
+		T* begin () {return _data;}
+		T* end () {return _data + _count;}
+		const T* begin () const {return _data;}
+		const T* end () const {return _data + _count;}
+
+		void Clear () {_count = 0;}
+
+		bool Reserve (size_t capacity)
+		{
+			if (capacity <= _capacity){
+				return true;
+			}
+			if (_data != nullptr && _arena->Extend (_data, _capacity*sizeof (T), capacity*sizeof (T))){
+				_capacity = capacity;
+				return true;
+			}
+			T* data = static_cast <T*> (_arena->Allocate (capacity*sizeof (T), alignof (T)));
+			if (data == nullptr){
+				return false;
+			}
+			for (size_t i = 0; i < _count; ++i){
+				new (data + i) T (std::move (_data [i]));
+			}
+			_data = data;
+			_capacity = capacity;
+			return true;
+		}
+
+		inline void PushBack (const T& e)
+		{
+			if (_count == _capacity && !Reserve (_capacity == 0 ? 16 : 2*_capacity)){
+				LOG_ERROR ("Frame arena exhausted. Could not add more elements");
+				return;
+			}
+			new (_data + _count) T (e);
+			++_count;
+		}
+
+		template <class... Args> inline T* EmplaceBack (Args&&... args)
+		{
+			if (_count == _capacity && !Reserve (_capacity == 0 ? 16 : 2*_capacity)){
+				LOG_ERROR ("Frame arena exhausted. Could not add more elements");
+				return nullptr;
+			}
+			T* e = new (_data + _count) T (std::forward <Args> (args)...);
+			++_count;
+			return e;
+		}
+	};
+}
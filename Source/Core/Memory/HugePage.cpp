@@ -0,0 +1,95 @@
+/**
+ * @file HugePage.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See HugePage.h.
+ */
+#include <algorithm>
+#include <cstdint>
+
+#include <sys/mman.h>
+
+#include "Preprocess.h"
+#include "Log.h"
+#include "Memory/HugePage.h"
+#include "Tasks/TaskManager.h"
+
+namespace Sim {
+
+	namespace {
+
+		const size_t SIM_SMALL_PAGE_SIZE = 4096;
+
+		inline size_t RoundUp (size_t bytes, size_t multiple)
+		{
+			return (bytes + multiple - 1)/multiple*multiple;
+		}
+	}
+
+	void* AllocateHugePages (size_t bytes, bool* huge)
+	{
+		size_t length = RoundUp (bytes, SIM_HUGE_PAGE_SIZE);
+		if (huge != nullptr){
+			*huge = false;
+		}
+
+		// explicitly reserved huge pages (fails unless vm.nr_hugepages is large enough)
+#		ifdef MAP_HUGETLB
+		void* memory = mmap (nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (memory != MAP_FAILED){
+			if (huge != nullptr){
+				*huge = true;
+			}
+			return memory;
+		}
+#		endif
+
+		// otherwise map a little more than needed so that the range can be trimmed to 2 MB alignment
+		size_t span = length + SIM_HUGE_PAGE_SIZE;
+		unsigned char* base = static_cast <unsigned char*> (mmap (nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+		if (base == MAP_FAILED){
+			LOG_ERROR ("Could not map " << bytes << " bytes");
+			return nullptr;
+		}
+		unsigned char* aligned = reinterpret_cast <unsigned char*> (RoundUp (reinterpret_cast <uintptr_t> (base), SIM_HUGE_PAGE_SIZE));
+		if (aligned != base){
+			munmap (base, aligned - base);
+		}
+		if (aligned + length != base + span){
+			munmap (aligned + length, (base + span) - (aligned + length));
+		}
+
+		// ask for transparent huge pages (normal pages are used if they are disabled)
+#		ifdef MADV_HUGEPAGE
+		if (madvise (aligned, length, MADV_HUGEPAGE) == 0 && huge != nullptr){
+			*huge = true;
+		}
+#		endif
+		return aligned;
+	}
+
+	void FreeHugePages (void* memory, size_t bytes)
+	{
+		if (memory != nullptr){
+			munmap (memory, RoundUp (bytes, SIM_HUGE_PAGE_SIZE));
+		}
+	}
+
+	void ParallelFirstTouch (TaskManager* tasks, size_t count, size_t elementSize, void (*touch) (void* data, size_t begin, size_t end), void* data)
+	{
+		if (tasks == nullptr || tasks->Concurrency () < 2 || count*elementSize < SIM_FIRST_TOUCH_PARALLEL_SIZE){
+			touch (data, 0, count);
+			return;
+		}
+
+		// split into whole pages so that no page is first touched by two workers
+		size_t pageElements = elementSize < SIM_SMALL_PAGE_SIZE ? SIM_SMALL_PAGE_SIZE/elementSize : 1;
+		size_t pages = (count + pageElements - 1)/pageElements;
+		tasks->ParallelFor (0, pages, [touch, data, count, pageElements] (size_t begin, size_t end) {
+			touch (data, begin*pageElements, std::min (end*pageElements, count));
+		});
+	}
+}
@@ -0,0 +1,183 @@
+/**
+ * @file HugePage.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Allocation path for large, long-lived buffers (vertex and face arrays,
+ * volume stacks) backed by huge pages, so that sweeping them does not
+ * thrash the TLB. Memory is mapped with MAP_HUGETLB when the system has
+ * reserved huge pages; otherwise a 2 MB aligned anonymous mapping is
+ * advised with MADV_HUGEPAGE (transparent huge pages), and if that is not
+ * available either, normal pages are used.
+ * Pages are physically placed by the first thread that writes them, so
+ * large buffers are first touched (and their elements constructed) by
+ * the workers of the task manager when one is given, which are the
+ * threads that sweep them later. Otherwise the calling thread touches
+ * them.
+ * 1) HugeBuffer <T>: owning array, the replacement for unique_ptr <T []>.
+ * 2) HugePageAllocator <T>: standard allocator for large std::vectors.
+ */
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Sim {
+
+	class TaskManager;
+
+	// size of a (x86-64) huge page
+	const size_t SIM_HUGE_PAGE_SIZE = 2 << 20;
+	// smaller requests are served from the heap
+	const size_t SIM_HUGE_PAGE_THRESHOLD = 1 << 20;
+	// smaller buffers are first touched by the calling thread alone
+	const size_t SIM_FIRST_TOUCH_PARALLEL_SIZE = 8 << 20;
+
+	/**
+	 * Maps at least 'bytes' bytes of zeroed memory, 2 MB aligned. Returns
+	 * nullptr on failure. 'huge' (if given) is set to true if the mapping is
+	 * backed by huge pages (explicitly or advised).
+	 */
+	void* AllocateHugePages (size_t bytes, bool* huge = nullptr);
+	void FreeHugePages (void* memory, size_t bytes);
+
+	/**
+	 * Calls 'touch (begin, end)' for ranges of [0, count) through the
+	 * ParallelFor () of 'tasks', ranges being aligned to whole 4 KB pages of
+	 * elements of 'elementSize' bytes. Without a task manager, and for small
+	 * counts, the calling thread touches the whole range.
+	 */
+	void ParallelFirstTouch (TaskManager* tasks, size_t count, size_t elementSize, void (*touch) (void* data, size_t begin, size_t end), void* data);
+
+	template <class T> class HugeBuffer {
+
+	private:
+		T* _data = nullptr;
+		size_t _count = 0;
+		bool _mapped = false;
+
+	public:
+		HugeBuffer () = default;
+		~HugeBuffer () {reset ();}
+
+		HugeBuffer (const HugeBuffer&) = delete;
+		HugeBuffer& operator = (const HugeBuffer&) = delete;
+
+		HugeBuffer (HugeBuffer&& b) : _data (b._data), _count (b._count), _mapped (b._mapped)
+		{
+			b._data = nullptr;
+			b._count = 0;
+		}
+		HugeBuffer& operator = (HugeBuffer&& b)
+		{
+			if (this != &b){
+				reset ();
+				std::swap (_data, b._data);
+				std::swap (_count, b._count);
+				std::swap (_mapped, b._mapped);
+			}
+			return *this;
+		}
+
+		/**
+		 * Allocates and value-initializes 'count' elements (on the workers of
+		 * 'tasks' for large buffers). Any previous contents are released.
+		 * Returns false on failure.
+		 */
+		bool Allocate (size_t count, TaskManager* tasks = nullptr)
+		{
+			reset ();
+			if (count == 0){
+				return true;
+			}
+			size_t bytes = count*sizeof (T);
+			if (bytes >= SIM_HUGE_PAGE_THRESHOLD){
+				_data = static_cast <T*> (AllocateHugePages (bytes));
+				_mapped = true;
+			}
+			else {
+				_data = static_cast <T*> (::operator new (bytes, std::nothrow));
+				_mapped = false;
+			}
+			if (_data == nullptr){
+				return false;
+			}
+			_count = count;
+			ParallelFirstTouch (tasks, count, sizeof (T), &HugeBuffer::Construct, _data);
+			return true;
+		}
+
+		void reset ()
+		{
+			if (_data == nullptr){
+				return;
+			}
+			if (!std::is_trivially_destructible <T>::value){
+				for (size_t i = 0; i < _count; ++i){
+					_data [i].~T ();
+				}
+			}
+			if (_mapped){
+				FreeHugePages (_data, _count*sizeof (T));
+			}
+			else {
+				::operator delete (_data);
+			}
+			_data = nullptr;
+			_count = 0;
+		}
+
+		T* get () const {return _data;}
+		size_t size () const {return _count;}
+		explicit operator bool () const {return _data != nullptr;}
+
+		T& operator [] (size_t index) {return _data [index];}
+		const T& operator [] (size_t index) const {return _data [index];}
+
+	private:
+		static void Construct (void* data, size_t begin, size_t end)
+		{
+			T* t = static_cast <T*> (data);
+			for (size_t i = begin; i < end; ++i){
+				new (t + i) T ();
+			}
+		}
+	};
+
+	// standard allocator adaptor: large requests are mapped on huge pages
+	template <class T> class HugePageAllocator {
+
+	public:
+		typedef T value_type;
+		typedef std::true_type is_always_equal;
+
+		HugePageAllocator () = default;
+		template <class U> HugePageAllocator (const HugePageAllocator <U>&) {}
+
+		T* allocate (size_t n)
+		{
+			void* memory = n*sizeof (T) >= SIM_HUGE_PAGE_THRESHOLD ? AllocateHugePages (n*sizeof (T)) : ::operator new (n*sizeof (T));
+			if (memory == nullptr){
+				throw std::bad_alloc ();
+			}
+			return static_cast <T*> (memory);
+		}
+
+		void deallocate (T* memory, size_t n)
+		{
+			if (n*sizeof (T) >= SIM_HUGE_PAGE_THRESHOLD){
+				FreeHugePages (memory, n*sizeof (T));
+			}
+			else {
+				::operator delete (memory);
+			}
+		}
+	};
+
+	template <class T, class U> inline bool operator == (const HugePageAllocator <T>&, const HugePageAllocator <U>&) {return true;}
+	template <class T, class U> inline bool operator != (const HugePageAllocator <T>&, const HugePageAllocator <U>&) {return false;}
+}
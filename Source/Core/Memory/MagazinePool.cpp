@@ -0,0 +1,205 @@
+/**
+ * @file MagazinePool.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See MagazinePool.h.
+ */
+#include <mutex>
+
+#include "Preprocess.h"
+#include "Log.h"
+#include "Memory/MemoryPool.h"
+#include "Memory/MagazinePool.h"
+
+namespace Sim {
+
+	struct Magazine {
+		unsigned int _epoch = 0;
+		unsigned int _count = 0;
+		void* _pages [2*SIM_MAGAZINE_MAX_BATCH];
+	};
+
+	namespace {
+
+		// slot table shared by all magazine pools (only touched on setup, teardown and thread exit)
+		struct MagazineRegistry {
+			std::mutex _mutex;
+			MagazinePool* _pools [SIM_MAGAZINE_MAX_POOLS] = {nullptr};
+			MemoryPool* _shared [SIM_MAGAZINE_MAX_POOLS] = {nullptr};
+			unsigned int _epochs [SIM_MAGAZINE_MAX_POOLS] = {0};
+		};
+
+		MagazineRegistry& Registry ()
+		{
+			// never destroyed: thread caches may be flushed after static destruction starts
+			static MagazineRegistry* registry = new MagazineRegistry;
+			return *registry;
+		}
+
+		// set once the calling thread's cache is gone (trivial type, so it outlives the cache)
+		thread_local bool t_cacheDestroyed = false;
+
+		// per-thread magazines, one per pool slot (allocated lazily)
+		struct ThreadCache {
+			Magazine* _magazines [SIM_MAGAZINE_MAX_POOLS] = {nullptr};
+
+			~ThreadCache ()
+			{
+				t_cacheDestroyed = true;
+
+				MagazineRegistry& r = Registry ();
+				std::lock_guard <std::mutex> loki (r._mutex);
+
+				for (unsigned int i = 0; i < SIM_MAGAZINE_MAX_POOLS; ++i){
+					Magazine* m = _magazines [i];
+					if (m == nullptr){
+						continue;
+					}
+					// hand pages back only if the pool that filled this magazine is still alive
+					if (r._pools [i] != nullptr && r._epochs [i] == m->_epoch && m->_count > 0){
+						r._shared [i]->FreeBatch (m->_pages, m->_count);
+					}
+					delete m;
+					_magazines [i] = nullptr;
+				}
+			}
+		};
+
+		thread_local ThreadCache t_cache;
+	}
+
+	MagazinePool::~MagazinePool ()
+	{
+		Cleanup ();
+	}
+
+	bool MagazinePool::Initialize (unsigned int pageSize, unsigned int numPages, unsigned int batchSize, unsigned int alignment)
+	{
+		if (_slot < SIM_MAGAZINE_MAX_POOLS){
+			LOG_WARNING ("Current magazine pool is not empty. All allocated memory will be destroyed");
+			Cleanup ();
+		}
+
+		if (batchSize == 0 || batchSize > SIM_MAGAZINE_MAX_BATCH){
+			LOG_WARNING ("Magazine batch size " << batchSize << " clamped to " << SIM_MAGAZINE_MAX_BATCH);
+			batchSize = batchSize == 0 ? 1 : SIM_MAGAZINE_MAX_BATCH;
+		}
+		_batchSize = batchSize;
+
+		if (!_pool.Initialize (pageSize, numPages, alignment)){
+			LOG_ERROR ("Could not initialize memory pool for magazines");
+			return false;
+		}
+
+		// claim a slot in the per-thread tables
+		MagazineRegistry& r = Registry ();
+		std::lock_guard <std::mutex> loki (r._mutex);
+		for (unsigned int i = 0; i < SIM_MAGAZINE_MAX_POOLS; ++i){
+			if (r._pools [i] == nullptr){
+				r._pools [i] = this;
+				r._shared [i] = &_pool;
+				_slot = i;
+				_epoch = ++r._epochs [i];
+				return true;
+			}
+		}
+
+		// no slot available: the pool still works, but every call takes the lock
+		LOG_WARNING ("All " << SIM_MAGAZINE_MAX_POOLS << " magazine slots in use. Pool will not be thread-cached");
+		return true;
+	}
+
+	void MagazinePool::Cleanup ()
+	{
+		if (_slot < SIM_MAGAZINE_MAX_POOLS){
+			MagazineRegistry& r = Registry ();
+			std::lock_guard <std::mutex> loki (r._mutex);
+			r._pools [_slot] = nullptr;
+			r._shared [_slot] = nullptr;
+			++r._epochs [_slot];
+			_slot = SIM_MAGAZINE_MAX_POOLS;
+		}
+		_pool.Cleanup ();
+	}
+
+	void* MagazinePool::Allocate ()
+	{
+		if (_slot >= SIM_MAGAZINE_MAX_POOLS){
+			return _pool.Allocate ();
+		}
+
+		Magazine* m = LocalMagazine ();
+		if (m == nullptr){
+			return _pool.Allocate ();
+		}
+		if (m->_count == 0){
+			m->_count = _pool.AllocateBatch (m->_pages, _batchSize);
+			if (m->_count == 0){
+				return nullptr;
+			}
+		}
+		return m->_pages [--m->_count];
+	}
+
+	void MagazinePool::Free (void* memoryPointer)
+	{
+		if (memoryPointer == nullptr){
+			return;
+		}
+		if (_slot >= SIM_MAGAZINE_MAX_POOLS){
+			_pool.Free (memoryPointer);
+			return;
+		}
+
+		Magazine* m = LocalMagazine ();
+		if (m == nullptr){
+			_pool.Free (memoryPointer);
+			return;
+		}
+		if (m->_count == 2*_batchSize){
+			// magazine is full: flush the older half to the shared pool
+			_pool.FreeBatch (m->_pages, _batchSize);
+			for (unsigned int i = 0; i < _batchSize; ++i){
+				m->_pages [i] = m->_pages [_batchSize + i];
+			}
+			m->_count = _batchSize;
+		}
+		m->_pages [m->_count++] = memoryPointer;
+	}
+
+	void MagazinePool::Flush ()
+	{
+		if (_slot >= SIM_MAGAZINE_MAX_POOLS){
+			return;
+		}
+		Magazine* m = LocalMagazine ();
+		if (m == nullptr){
+			return;
+		}
+		_pool.FreeBatch (m->_pages, m->_count);
+		m->_count = 0;
+	}
+
+	Magazine* MagazinePool::LocalMagazine ()
+	{
+		// thread is exiting (or static destructors are running on the main thread)
+		if (t_cacheDestroyed){
+			return nullptr;
+		}
+
+		Magazine*& m = t_cache._magazines [_slot];
+		if (m == nullptr){
+			m = new Magazine;
+			m->_epoch = _epoch;
+		}
+		// magazine was filled by a pool that has since been cleaned up: drop its pages
+		if (m->_epoch != _epoch){
+			m->_epoch = _epoch;
+			m->_count = 0;
+		}
+		return m;
+	}
+}
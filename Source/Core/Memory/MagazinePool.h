@@ -0,0 +1,75 @@
+/**
+ * @file MagazinePool.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Thread-caching front-end for the MemoryPool. Every thread that touches
+ * a MagazinePool gets its own magazine - a small stack of free pages -
+ * for that pool. Allocate () and Free () only touch the calling thread's
+ * magazine; the shared (locked) MemoryPool is visited once per batch of
+ * pages, when a magazine runs empty (refill) or overflows (flush). This
+ * makes it cheap to create and destroy pooled objects from scheduler
+ * worker threads.
+ * Pages may be freed by a different thread than the one that allocated
+ * them. Pages cached by other threads at the time the pool is cleaned up
+ * are simply dropped (the memory itself belongs to the MemoryPool).
+ */
+#pragma once
+
+#include <cstddef>
+
+#include "Memory/MemoryPool.h"
+
+namespace Sim {
+
+	// upper limits on the number of live magazine pools and the batch size
+	const unsigned int SIM_MAGAZINE_MAX_POOLS = 64;
+	const unsigned int SIM_MAGAZINE_MAX_BATCH = 64;
+
+	class MagazinePool {
+
+	private:
+		MemoryPool _pool;
+		// index of this pool in the per-thread magazine tables
+		unsigned int _slot = SIM_MAGAZINE_MAX_POOLS;
+		// incremented whenever the slot is (re)used so stale magazines get dropped
+		unsigned int _epoch = 0;
+		// number of pages moved between a magazine and the shared pool at a time
+		unsigned int _batchSize = 0;
+
+	public:
+		MagazinePool () = default;
+		~MagazinePool ();
+
+		MagazinePool (const MagazinePool&) = delete;
+		MagazinePool& operator = (const MagazinePool&) = delete;
+
+		/**
+		 * Initializes the underlying pool. Each thread may cache up to 2*batchSize
+		 * pages, so numPages should be sized for the number of worker threads or
+		 * resizing should be allowed. See MemoryPool::Initialize () for alignment.
+		 */
+		bool Initialize (unsigned int pageSize, unsigned int numPages, unsigned int batchSize = 16,
+				unsigned int alignment = alignof (std::max_align_t));
+		void Cleanup ();
+
+		void* Allocate ();
+		void Free (void* memoryPointer);
+
+		// returns all pages cached by the calling thread to the shared pool
+		void Flush ();
+
+		unsigned int PageSize () const {return _pool.PageSize ();}
+		void AllowResize (bool flag) {_pool.AllowResize (flag);}
+
+		// pages cached in magazines count as live in the pool statistics
+		bool Track (MemoryTag tag, const char* name) {return _pool.Track (tag, name);}
+		MemoryPoolStats Stats () {return _pool.Stats ();}
+
+	private:
+		// nullptr once the calling thread's cache has been destroyed
+		struct Magazine* LocalMagazine ();
+	};
+}
@@ -5,108 +5,121 @@
  * See LICENSE.txt included in this package
  *
  * @section DESCRIPTION
- * Macros designed to allow classes to easily take advantage of memory pools. The
- * memory pool in this context is supposed to be an abstraction for certain classes
- * that are dynamically allocated and deallocated during the lifetime of the appli-
- * cation. Note that this is not a global general memory pool class but local to the
- * class itself. To use, follow this steps:
- * 1) Call SIM_MEMORY_DECLARE_CLASS () in class declaration (.h file)
- * 2) Call SIM_MEMORY_DEFINE_CLASS () in class definition (.cpp file)
- * 3) Call SIM_MEMORYPOOL_AUTOINITIALIZE () for memory pool autoinitiation (.cpp file)
- *
- * NOTE: Based on Game Coding Complete code.
- * SECOND NOTE: All debug features except assert() have been removed from original code.
+ * Helpers that let classes and containers take advantage of memory pools.
+ * Objects that are frequently created and destroyed during the lifetime of
+ * the application draw their memory from a pool shared by all types of the
+ * same size and alignment, instead of scattered heap allocations.
+ * 1) Pooled <T>: derive T from it (CRTP) and 'new T' comes from the pool.
+ * 2) PoolAllocator <T>: standard allocator for node based containers (map,
+ *    set, list). Single nodes come from the pool; arrays go to the heap.
+ * 3) PooledMap <K, V>: std::map using PoolAllocator.
+ * The pools are created on first use and never destroyed, so pooled objects
+ * may safely be released during static destruction.
  */
 #pragma once
 
-#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 #include "Preprocess.h"
-#include "Memory/MemoryPool.h"
+#include "Memory/MagazinePool.h"
 
-/**
- * This macro is placed inside the body of the class that you want to use a memory pool with.  It declares the
-// overloaded new and delete operators as well as the static MemoryPool object.
-//
-// IMPORTANT: InitMemoryPool() and DestroyMemoryPool() must be called manually unless you use the GCC_MEMORYPOOL_AUTOINIT()
-// macro below.
-//---------------------------------------------------------------------------------------------------------------------
- */
-#define SIM_MEMORY_DECLARE_CLASS(_defaultNumPages_) \
-    public: \
-			static MemoryPool* _memoryPool; \
-			static void InitializePool (unsigned int numChunks = _defaultNumPages_); \
-			static void DestroyPool (void); \
-			static void* operator new (size_t size); \
-			static void operator delete (void* pointer); \
-			static void* operator new [] (size_t size); \
-			static void operator delete [] (void* pPtr); \
-    private: \
+namespace Sim {
 
-/**
- * This macro defines the definition for the overloaded new & delete operators on a
- * class meant to be pooled with a memory pool.  It is meant to work specifically with
- * the MemoryPool class.  To use it, call this macro from the .cpp file where the class
- * function definitions are - _className_: name of this class.
- */
-#define SIM_MEMORY_DEFINE_CLASS(_className_) \
-	MemoryPool* _className_::_memoryPool = nullptr; \
-	void _className_::InitializePool (unsigned int numPages) \
-	{ \
-		if (_memoryPool != nullptr) \
-		{ \
-			LOG_ERROR("Memory pool not empty. Previous data will be destroyed."); \
-			SAFE_DELETE (_memoryPool); \
-		} \
-		_memoryPool = new MemoryPool; \
-		_memoryPool->Initialize (sizeof (_className_), numChunks); \
-	} \
-	void _className_::Cleanup () \
-	{ \
-		assert (_memoryPool != nullptr); \
-		SAFE_DELETE (_memoryPool); \
-	} \
-	void* _className_::operator new (size_t size) \
-	{ \
-		assert (_memoryPool != nullptr); \
-		void* memory = _memoryPool->Allocate (); \
-		return pMem; \
-	} \
-	void _className_::operator delete (void* memory) \
-	{ \
-		assert (_memoryPool != nullptr); \
-		_memoryPool->Free (memory); \
-	} \
-	void* _className_::operator new [] (size_t size) \
-	{ \
-		assert (_memoryPool != nullptr); \
-		void* memory = _memoryPool->Allocate (); \
-		return memory; \
-	} \
-	void _className_::operator delete [] (void* memory) \
-	{ \
-		assert (_memoryPool != nullptr); \
-		s_pMemoryPool->Free (memory); \
-	} \
+	// number of pages in the first block of every size class pool
+	const unsigned int SIM_POOL_DEFAULT_PAGES = 64;
 
-/**
- * This macro defines a static class that automatically initializes a memory pool
- * at global startup and destroys it at global destruction time. Using this gets
- * around the requirement of manually initializing and destroying the memory pool.
- */
-#define SIM_MEMORYPOOL_AUTOINITIALIZE(_className_, _numPages_) \
-	class _className_ ## _AutoInitializePool \
-	{ \
-	public: \
-		_className_ ## _AutoInitializePool (); \
-		~_className_ ## _AutoInitializePool (); \
-	}; \
-	_className_ ## _AutoInitializePool::_className_ ## _AutoInitializePool () \
-	{ \
-		_className_::InitializePool (_numChunks_); \
-	} \
-	_className_ ## _AutoInitializePool::~_className_ ## _AutoInitializePool () \
-	{ \
-		_className_::Cleanup (); \
-	} \
-	static _className_ ## _AutoInitializePool static_ ## _className_ ## _AutoInitializePool; \
+	/**
+	 * Returns the pool for pages of 'Size' bytes aligned on 'Align'. All classes
+	 * and containers with the same size and alignment share one pool.
+	 */
+	template <size_t Size, size_t Align> MagazinePool& SizeClassPool ()
+	{
+		static MagazinePool* pool = [] () {
+			MagazinePool* p = new MagazinePool;
+			p->Initialize (Size, SIM_POOL_DEFAULT_PAGES, 16, Align);
+			p->AllowResize (true);
+			return p;
+		} ();
+		return *pool;
+	}
+
+	/**
+	 * CRTP base for pooled classes: class Foo : public Pooled <Foo> {...};
+	 * Derived classes of a different size fall back to the global heap, as do
+	 * array allocations.
+	 */
+	template <class T> class Pooled {
+
+	protected:
+		Pooled () = default;
+		~Pooled () = default;
+
+	public:
+		static void* operator new (size_t size)
+		{
+			if (size != sizeof (T)){
+				return ::operator new (size);
+			}
+			void* memory = SizeClassPool <sizeof (T), alignof (T)> ().Allocate ();
+			if (memory == nullptr){
+				throw std::bad_alloc ();
+			}
+			return memory;
+		}
+
+		static void operator delete (void* memory, size_t size)
+		{
+			if (size != sizeof (T)){
+				::operator delete (memory);
+				return;
+			}
+			SizeClassPool <sizeof (T), alignof (T)> ().Free (memory);
+		}
+
+		static void* operator new [] (size_t size) {return ::operator new (size);}
+		static void operator delete [] (void* memory) {::operator delete (memory);}
+	};
+
+	// standard allocator adaptor drawing single objects from the size class pools
+	template <class T> class PoolAllocator {
+
+	public:
+		typedef T value_type;
+		typedef std::true_type is_always_equal;
+
+		PoolAllocator () = default;
+		template <class U> PoolAllocator (const PoolAllocator <U>&) {}
+
+		T* allocate (size_t n)
+		{
+			if (n != 1){
+				return static_cast <T*> (::operator new (n*sizeof (T)));
+			}
+			void* memory = SizeClassPool <sizeof (T), alignof (T)> ().Allocate ();
+			if (memory == nullptr){
+				throw std::bad_alloc ();
+			}
+			return static_cast <T*> (memory);
+		}
+
+		void deallocate (T* memory, size_t n)
+		{
+			if (n != 1){
+				::operator delete (memory);
+				return;
+			}
+			SizeClassPool <sizeof (T), alignof (T)> ().Free (memory);
+		}
+	};
+
+	template <class T, class U> inline bool operator == (const PoolAllocator <T>&, const PoolAllocator <U>&) {return true;}
+	template <class T, class U> inline bool operator != (const PoolAllocator <T>&, const PoolAllocator <U>&) {return false;}
+
+	template <class K, class V, class C = std::less <K> >
+	using PooledMap = std::map <K, V, C, PoolAllocator <std::pair <const K, V> > >;
+}
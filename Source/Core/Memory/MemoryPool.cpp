@@ -8,134 +8,245 @@
  * See MemoryPool.h.
  */
 #include <cstdlib>
+#include <cstddef>
+#include <mutex>
 
 #include "Preprocess.h"
+#include "Log.h"
+#include "Memory/MemoryTracker.h"
 #include "Memory/MemoryPool.h"
 
 namespace Sim {
-	const static size_t SIM_MEMORY_PAGE_HEADER_SIZE = (sizeof (unsigned char*));
 
 	MemoryPool::~MemoryPool ()
 	{
 		Cleanup ();
 	}
 
-	// function to initialize the memory pool with specified page size and number of pages
-	bool MemoryPool::Initialize (unsigned int pageSize, unsigned int numPages)
+	// function to initialize the memory pool with specified page size, number of pages and alignment
+	bool MemoryPool::Initialize (unsigned int pageSize, unsigned int numPages, unsigned int alignment)
 	{
-		if (_rawArray != nullptr){
-			LOG_WARNING ("Current memory pool is not empty. All allocated memory will be destroyed");
-			Cleanup ();
+		if (numPages == 0){
+			LOG_ERROR ("Cannot initialize memory pool with zero pages");
+			return false;
+		}
+		if (alignment & (alignment - 1)){
+			LOG_ERROR ("Memory pool alignment " << alignment << " is not a power of two");
+			return false;
+		}
+
+		bool grown = false;
+		{
+			std::lock_guard <std::mutex> loki (_mutex);
+
+			if (_blocks != nullptr){
+				LOG_WARNING ("Current memory pool is not empty. All allocated memory will be destroyed");
+				FreeBlocks ();
+				Reset ();
+			}
+
+			// a free page must be able to hold the link to the next free page
+			_alignment = alignment < sizeof (unsigned char*) ? sizeof (unsigned char*) : alignment;
+			_pageSize = pageSize;
+			_stride = pageSize < sizeof (unsigned char*) ? sizeof (unsigned char*) : pageSize;
+			_stride = (_stride + _alignment - 1) & ~(_alignment - 1);
+			_numPages = numPages;
+			_nextPages = numPages;
+
+			grown = GrowArray ();
 		}
-		_pageSize = pageSize;
-		_numPages = numPages;
 
-		return GrowArray ();
+		// outside the pool lock: the tracker locks itself, then the pools, to report them
+#		ifdef SIM_MEMORY_STATS_ENABLED
+		if (grown){
+			MemoryTracker::Instance ().RegisterPool (this);
+		}
+		else {
+			MemoryTracker::Instance ().UnregisterPool (this);
+		}
+#		endif
+		return grown;
 	}
 
 	// completely destroy the memory pool
 	void MemoryPool::Cleanup ()
 	{
-		for (unsigned int i = 0; i < _numArrays; ++i){
-			free (_rawArray [i]);
-		}
-		free (_rawArray);
-		_rawArray = nullptr;
+#		ifdef SIM_MEMORY_STATS_ENABLED
+		MemoryTracker::Instance ().UnregisterPool (this);
+#		endif
+
+		std::lock_guard <std::mutex> loki (_mutex);
+
+		FreeBlocks ();
+		Reset ();
 	}
 
 	// returns a pointer to a new page of memory
 	void* MemoryPool::Allocate ()
 	{
-		// if we are out of memory, grow pool or return null if reallocation not allowed
-		if (_head == nullptr){
-			if (!_allowResize){
-				return nullptr;
-			}
-			if (!GrowArray ()){
-				return nullptr;
-			}
-		}
-
-		unsigned char* current = _head;
-		_head = GetNext (_head);
-		return current + SIM_MEMORY_PAGE_HEADER_SIZE; // returns pointer to data section of page
+		std::lock_guard <std::mutex> loki (_mutex);
+		return AllocatePage ();
 	}
 
 	// returns page to the pool
 	void MemoryPool::Free (void* memoryPtr)
 	{
 		if (memoryPtr != nullptr){
-			unsigned char* pagePtr = (unsigned char*)memoryPtr - SIM_MEMORY_PAGE_HEADER_SIZE;
-			SetNext (pagePtr, _head);
-			_head = pagePtr;
+			std::lock_guard <std::mutex> loki (_mutex);
+			FreePage (memoryPtr);
 		}
 	}
 
-	// function to allocate a new memory array and add it to the pool (expensive operation)
-	bool MemoryPool::GrowArray ()
+	// retrieves up to 'count' pages under a single lock
+	unsigned int MemoryPool::AllocateBatch (void** pages, unsigned int count)
 	{
-		// allocate and check if new allocation is successful
-		unsigned char** newArray = (unsigned char**) malloc ((_numArrays + 1) * SIM_MEMORY_PAGE_HEADER_SIZE);
-		if (newArray == nullptr){
-			return false;
-		}
+		std::lock_guard <std::mutex> loki (_mutex);
 
-		// copy existent memory pointers to newly allocated array
-		for (unsigned int i = 0; i < _numArrays; ++i){
-			newArray [i] = _rawArray [i];
+		unsigned int i = 0;
+		for (; i < count; ++i){
+			pages [i] = AllocatePage ();
+			if (pages [i] == nullptr){
+				break;
+			}
 		}
-		// allocate new memory chunk
-		newArray [_numArrays] = AllocateNewBlock ();
+		return i;
+	}
 
-		// attach block to end of current memory list
-		if (_head != nullptr){
-			unsigned char* current = _head;
-			unsigned char* next = GetNext (_head);
-			while (next)
-			{
-				current = next;
-				next = GetNext (next);
+	// returns 'count' pages to the pool under a single lock
+	void MemoryPool::FreeBatch (void** pages, unsigned int count)
+	{
+		std::lock_guard <std::mutex> loki (_mutex);
+
+		for (unsigned int i = 0; i < count; ++i){
+			if (pages [i] != nullptr){
+				FreePage (pages [i]);
 			}
-			SetNext (current, newArray [_numArrays]);
-		}
-		else {
-			_head = newArray [_numArrays];
 		}
+	}
 
-		// destroy any old allocated array
-		if (_rawArray != nullptr){
-			free (_rawArray);
-		}
+	bool MemoryPool::Track (MemoryTag tag, const char* name)
+	{
+		std::lock_guard <std::mutex> loki (_mutex);
 
-		// point internal array to newly allocated array
-		_rawArray = newArray;
-		++_numArrays;
+		// move the blocks allocated so far to the new tag
+		if (_reservedBytes > 0 && tag != _tag){
+			if (!MemoryTracker::Instance ().Allocate (tag, _reservedBytes)){
+				LOG_ERROR ("Memory pool blocks of " << _reservedBytes << " bytes exceed the " << tag << " budget, pool not retagged");
+				return false;
+			}
+			MemoryTracker::Instance ().Free (_tag, _reservedBytes);
+		}
+		_tag = tag;
+		_name = name;
 		return true;
 	}
 
-	// allocates a new memory block
-	unsigned char* MemoryPool::AllocateNewBlock ()
+	MemoryPoolStats MemoryPool::Stats ()
+	{
+#		ifdef SIM_MEMORY_STATS_ENABLED
+		std::lock_guard <std::mutex> loki (_mutex);
+		return _stats;
+#		else
+		return MemoryPoolStats ();
+#		endif
+	}
+
+	void MemoryPool::Reset ()
 	{
-		size_t blockSize = _pageSize + SIM_MEMORY_PAGE_HEADER_SIZE;
-		size_t arraySize = _numPages * blockSize;
-		unsigned char* newBlock = (unsigned char*) malloc (arraySize);
-		if (newBlock == nullptr){
-			return nullptr;
+		_blocks = nullptr;
+		_head = nullptr;
+		_carve = nullptr;
+		_carveEnd = nullptr;
+		_nextPages = _numPages;
+		_numBlocks = 0;
+#		ifdef SIM_MEMORY_STATS_ENABLED
+		_stats = MemoryPoolStats ();
+#		endif
+	}
+
+	void MemoryPool::FreeBlocks ()
+	{
+		unsigned char* block = _blocks;
+		while (block != nullptr){
+			unsigned char* next = GetNext (block);
+			free (block);
+			block = next;
+		}
+		MemoryTracker::Instance ().Free (_tag, _reservedBytes);
+		_reservedBytes = 0;
+	}
+
+	unsigned char* MemoryPool::AllocatePage ()
+	{
+		unsigned char* current = nullptr;
+
+		// recycled pages first
+		if (_head != nullptr){
+			current = _head;
+			_head = GetNext (_head);
+		}
+		// then untouched pages of the newest block; grow if allowed when both run out
+		else if (_carve != _carveEnd || (_allowResize && GrowArray ())){
+			current = _carve;
+			_carve += _stride;
 		}
 
-		// turn raw memory block into singly linked list
-		unsigned char* current = newBlock;
-		unsigned char* end = current + arraySize;
-		while (current < end){
+#		ifdef SIM_MEMORY_STATS_ENABLED
+		if (current == nullptr){
+			++_stats._failures;
+		}
+		else if (++_stats._livePages > _stats._peakPages){
+			_stats._peakPages = _stats._livePages;
+		}
+#		endif
+		return current;
+	}
 
-			unsigned char* next = current + blockSize;
-			unsigned char** pageHead = (unsigned char**) current;
-			pageHead [0] = next < end ? next: nullptr;
+	void MemoryPool::FreePage (void* memoryPtr)
+	{
+		unsigned char* pagePtr = static_cast <unsigned char*> (memoryPtr);
+		SetNext (pagePtr, _head);
+		_head = pagePtr;
+#		ifdef SIM_MEMORY_STATS_ENABLED
+		--_stats._livePages;
+#		endif
+	}
 
-			current += blockSize;
+	// function to allocate a new memory block and put it in front of the block list (constant time)
+	bool MemoryPool::GrowArray ()
+	{
+		// the block header only holds the link to the previous block, padded to keep pages aligned
+		size_t header = (sizeof (unsigned char*) + _alignment - 1) & ~(size_t (_alignment) - 1);
+		size_t blockSize = header + size_t (_nextPages)*_stride;
+
+		if (!MemoryTracker::Instance ().Allocate (_tag, blockSize)){
+			LOG_ERROR ("Memory block of " << _nextPages << " pages exceeds the " << _tag << " budget");
+			return false;
+		}
+		void* memory = nullptr;
+		if (posix_memalign (&memory, _alignment, blockSize) != 0){
+			LOG_ERROR ("Could not allocate memory block of " << _nextPages << " pages");
+			MemoryTracker::Instance ().Free (_tag, blockSize);
+			return false;
 		}
+		_reservedBytes += blockSize;
+#		ifdef SIM_MEMORY_STATS_ENABLED
+		++_stats._grows;
+#		endif
+		unsigned char* newBlock = static_cast <unsigned char*> (memory);
+		SetNext (newBlock, _blocks);
+		_blocks = newBlock;
 
-		return newBlock;
+		// the pages are handed out lazily as the free list runs dry
+		_carve = newBlock + header;
+		_carveEnd = _carve + size_t (_nextPages)*_stride;
+
+		// grow geometrically (up to 1 << 30 pages per block)
+		++_numBlocks;
+		if (_nextPages < (1u << 30)){
+			_nextPages *= 2;
+		}
+		return true;
 	}
 
 	unsigned char* MemoryPool::GetNext (unsigned char* block)
@@ -6,40 +6,79 @@
  *
  * @section DESCRIPTION
  * The raw memory pool class for the Chimera system. A memory pool is
- * a pool of memory that's split into pages of equal size, each with a
- * 4-byte header. The header is treated as a pointer that points to the
- * next page, making the pool a singly-linked list of memory pages.
- * When the pool is first initialized via the Initialize () function, it
- * must be passed the page-size and the number of pages to be created.
- * These two values are immutable until the pool is destroyed and reini-
- * tialized. The page-size is the size of each page, minus the header,
- * in bytes.  The memory pool allocates the appropriate amount of memory
- * and sets up the data structure during initialization. Total memory usage
- * is be (NP*(PS + 4)+Ov), where NP is the number of pages, PS is the size
- * of each page, and Ov is the overhead for the class (currently 18 + (number
- * of reallocations * 4).
+ * a pool of memory that's split into pages of equal size. While a page
+ * is free, its first bytes are treated as a pointer to the next free
+ * page, making the free pages a singly-linked list; allocated pages
+ * carry no header at all. When the pool is first initialized via the
+ * Initialize () function, it must be passed the page-size, the number
+ * of pages in the first block and optionally the page alignment. Pages
+ * are spaced by the page-size rounded up to the alignment, so with an
+ * alignment of SIM_CACHE_LINE_SIZE a page never straddles a cache line
+ * (as long as it fits in one) and SIMD data can use aligned loads.
+ * Every time the pool runs dry and resizing is allowed, a new block
+ * twice the size of the previous one is added in constant time: blocks
+ * are kept in an intrusive list and their pages are carved off lazily,
+ * so neither the free list nor the block list is ever traversed.
+ * The free list is guarded by a mutex, so the pool may be shared between
+ * threads. Callers that allocate at a high rate from many threads should
+ * go through a MagazinePool, which amortizes the lock over batches.
+ * The blocks of a pool are charged to its MemoryTag (General unless set
+ * with Track ()). With SIM_MEMORY_STATS_ENABLED the pool also counts its
+ * live pages, their peak, the number of blocks added and the number of
+ * failed allocations.
  * Note: Adapted from Game Coding Complete code.
  */
 #pragma once
 
+#include <cstddef>
+#include <mutex>
+
+#include "Config.h"
+#include "Types.h"
+
 namespace Sim {
 
+	// page counters of a memory pool (all zero without SIM_MEMORY_STATS_ENABLED)
+	struct MemoryPoolStats {
+		unsigned int _livePages = 0;
+		unsigned int _peakPages = 0;
+		unsigned int _grows = 0;
+		unsigned int _failures = 0;
+	};
+
 	class MemoryPool {
 
 	private:
-		// array of memory blocks, each split up into pages and connected
-		unsigned char** _rawArray = nullptr;
-		// the front of the memory chunk linked list
+		// guards the free list and the block list
+		std::mutex _mutex;
+		// the most recently allocated block (blocks are chained through their headers)
+		unsigned char* _blocks = nullptr;
+		// the front of the free page linked list
 		unsigned char* _head = nullptr;
-		// size of single page in bytes
+		// untouched pages of the newest block that have not been handed out yet
+		unsigned char* _carve = nullptr;
+		unsigned char* _carveEnd = nullptr;
+		// size of single page in bytes as requested and as laid out in memory
 		unsigned int _pageSize = 0;
-		// number of pages in array
+		unsigned int _stride = 0;
+		// alignment of every page in bytes
+		unsigned int _alignment = 0;
+		// number of pages in the first block and in the next block to be added
 		unsigned int _numPages = 0;
-		// number elements in the memory array
-		unsigned int _numArrays = 0;
-		// true if we resize the memory pool when it fills up (expensive operation)
+		unsigned int _nextPages = 0;
+		// number of blocks allocated so far
+		unsigned int _numBlocks = 0;
+		// true if we resize the memory pool when it fills up
 		bool _allowResize = false;
 
+		// memory accounting
+		MemoryTag _tag = MemoryTag::General;
+		const char* _name = nullptr;
+		size_t _reservedBytes = 0;
+#		ifdef SIM_MEMORY_STATS_ENABLED
+		MemoryPoolStats _stats;
+#		endif
+
 	public:
 		MemoryPool () = default;
 		~MemoryPool ();
@@ -48,17 +87,20 @@ namespace Sim {
 		MemoryPool& operator = (const MemoryPool& m) = delete;
 
 	public:
-		bool Initialize (unsigned int pageSize, unsigned int numPages);
+		/**
+		 * Sets up the pool and allocates its first block of numPages pages. The
+		 * alignment must be a power of two (it is raised to pointer alignment if
+		 * smaller).
+		 */
+		bool Initialize (unsigned int pageSize, unsigned int numPages, unsigned int alignment = alignof (std::max_align_t));
 		void Cleanup ();
 
 		/**
-		 * Function to retrieve a page from the memory pool. This removes the head of
-		 * the linked list, sets the new head to the next page, and returns a pointer
-		 * to the data section of the old head.  If there are no more pages left and
-		 * resize is allowed, then another block of N pages is allocated, where N is
-		 * the number of pages passed into Initialize (). While this is typically a
-		 * very fast function, reallocation is costly, so initial sizes should be chosen
-		 * carefully.
+		 * Function to retrieve a page from the memory pool. This pops the head of
+		 * the free list or, if the list is empty, carves the next untouched page of
+		 * the newest block. If there are no more pages left and resize is allowed,
+		 * another block twice the size of the last one is allocated. Every call is
+		 * constant time apart from the malloc of a new block.
 		 */
 		void* Allocate ();
 		/**
@@ -67,15 +109,36 @@ namespace Sim {
 		 */
 		void Free (void *memoryPointer);
 
+		/**
+		 * Batched versions of Allocate () and Free () that take the lock only once.
+		 * AllocateBatch () fills 'pages' with up to 'count' pages and returns the
+		 * number actually retrieved (less than 'count' only if the pool is exhausted).
+		 */
+		unsigned int AllocateBatch (void** pages, unsigned int count);
+		void FreeBatch (void** pages, unsigned int count);
+
 		unsigned int PageSize () const {return _pageSize;}
+		unsigned int Alignment () const {return _alignment;}
 		void AllowResize (bool flag) {_allowResize = flag;}
 
+		// charges the pool's blocks to 'tag' and names it in memory reports, false if the budget of 'tag' refuses them
+		bool Track (MemoryTag tag, const char* name);
+
+		MemoryTag Tag () const {return _tag;}
+		const char* Name () const {return _name;}
+		size_t ReservedBytes () const {return _reservedBytes;}
+		MemoryPoolStats Stats ();
+
 	private:
 		void Reset (); // resets internal variables
+		void FreeBlocks ();
+
+		// unsynchronized page operations (caller must hold _mutex)
+		unsigned char* AllocatePage ();
+		void FreePage (void* memoryPointer);
 
-		// internal memory allocation helpers
+		// adds a new block in front of the block list
 		bool GrowArray ();
-		unsigned char* AllocateNewBlock ();
 
 		// internal linked list management
 		unsigned char* GetNext (unsigned char* block);
@@ -0,0 +1,120 @@
+/**
+ * @file MemoryTracker.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See MemoryTracker.h.
+ */
+#include <mutex>
+
+#include "Preprocess.h"
+#include "Log.h"
+#include "Memory/MemoryPool.h"
+#include "Memory/MemoryTracker.h"
+
+namespace Sim {
+
+	MemoryTracker& MemoryTracker::Instance ()
+	{
+		// never destroyed: pools may be cleaned up after static destruction starts
+		static MemoryTracker* tracker = new MemoryTracker;
+		return *tracker;
+	}
+
+	void MemoryTracker::SetBudget (MemoryTag tag, size_t bytes, BudgetPolicy policy)
+	{
+		TagStats& t = _tags [Index (tag)];
+		t._budget = bytes;
+		t._policy = policy;
+		t._overBudget.store (bytes > 0 && t._current.load () > bytes);
+	}
+
+	size_t MemoryTracker::Total () const
+	{
+		size_t total = 0;
+		for (unsigned int i = 0; i < SIM_MEMORY_NUM_TAGS; ++i){
+			total += _tags [i]._current.load (std::memory_order_relaxed);
+		}
+		return total;
+	}
+
+	void MemoryTracker::RegisterPool (MemoryPool* pool)
+	{
+		std::lock_guard <std::mutex> loki (_mutex);
+		for (unsigned int i = 0; i < _numPools; ++i){
+			if (_pools [i] == pool){
+				return;
+			}
+		}
+		if (_numPools == SIM_MEMORY_MAX_TRACKED_POOLS){
+			return; // still accounted for by tag, just not listed
+		}
+		_pools [_numPools++] = pool;
+	}
+
+	void MemoryTracker::UnregisterPool (MemoryPool* pool)
+	{
+		std::lock_guard <std::mutex> loki (_mutex);
+		for (unsigned int i = 0; i < _numPools; ++i){
+			if (_pools [i] == pool){
+				_pools [i] = _pools [--_numPools];
+				_pools [_numPools] = nullptr;
+				return;
+			}
+		}
+	}
+
+	void MemoryTracker::Report ()
+	{
+		for (unsigned int i = 0; i < SIM_MEMORY_NUM_TAGS - 1; ++i){
+			const TagStats& t = _tags [i];
+			if (t._peak.load () == 0 && t._budget == 0){
+				continue;
+			}
+			LOG ("Memory " << static_cast <MemoryTag> (i) << ": current " << t._current.load () << " bytes, peak "
+					<< t._peak.load () << " bytes, budget " << t._budget << " bytes (0 is unlimited), "
+					<< t._allocations.load () << " allocations, " << t._failures.load () << " refused");
+		}
+
+#		ifdef SIM_LOG_ENABLED
+		std::lock_guard <std::mutex> loki (_mutex);
+		for (unsigned int i = 0; i < _numPools; ++i){
+			MemoryPool* p = _pools [i];
+			MemoryPoolStats s = p->Stats ();
+			LOG ("Memory pool " << (p->Name () != nullptr ? p->Name () : "<unnamed>") << " (" << p->Tag () << ", "
+					<< p->PageSize () << " byte pages): " << p->ReservedBytes () << " bytes reserved, live pages "
+					<< s._livePages << ", peak " << s._peakPages << ", blocks " << s._grows << ", failures " << s._failures);
+		}
+#		endif
+	}
+
+	bool MemoryTracker::Charge (MemoryTag tag, size_t bytes)
+	{
+		TagStats& t = _tags [Index (tag)];
+
+		size_t current = t._current.fetch_add (bytes, std::memory_order_relaxed) + bytes;
+		if (t._budget > 0 && current > t._budget){
+			if (t._policy == BudgetPolicy::Fail){
+				t._current.fetch_sub (bytes, std::memory_order_relaxed);
+				t._failures.fetch_add (1, std::memory_order_relaxed);
+				LOG_ERROR ("Allocation of " << bytes << " bytes refused: " << tag << " budget of " << t._budget << " bytes exceeded");
+				return false;
+			}
+			// warn once every time the tag crosses its budget
+			if (!t._overBudget.exchange (true)){
+				LOG_WARNING (tag << " memory (" << current << " bytes) exceeds budget of " << t._budget << " bytes");
+			}
+		}
+		else if (t._overBudget.load (std::memory_order_relaxed)){
+			t._overBudget.store (false);
+		}
+
+		size_t peak = t._peak.load (std::memory_order_relaxed);
+		while (current > peak && !t._peak.compare_exchange_weak (peak, current, std::memory_order_relaxed)){
+		}
+		t._allocations.fetch_add (1, std::memory_order_relaxed);
+		return true;
+	}
+}
@@ -0,0 +1,103 @@
+/**
+ * @file MemoryTracker.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Accounting of large allocations by MemoryTag. Modules report the
+ * memory they reserve (pool blocks, vertex arrays, staging buffers)
+ * against a tag; the tracker keeps the current and peak bytes of each
+ * tag and enforces an optional budget per tag. Exceeding a budget
+ * either logs a warning (Log policy) or makes the allocation fail (Fail
+ * policy). Memory pools register themselves so that their page counters
+ * show up in the report.
+ * Without SIM_MEMORY_STATS_ENABLED the Allocate () / Free () hooks are
+ * empty inline functions and nothing is recorded.
+ */
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+
+#include "Config.h"
+#include "Types.h"
+
+namespace Sim {
+
+	class MemoryPool;
+
+	// what happens when a tag goes over its budget
+	enum class BudgetPolicy {
+		Log,
+		Fail
+	};
+
+	const unsigned int SIM_MEMORY_NUM_TAGS = static_cast <unsigned int> (MemoryTag::Unknown) + 1;
+	// maximum number of memory pools listed in the report
+	const unsigned int SIM_MEMORY_MAX_TRACKED_POOLS = 256;
+
+	class MemoryTracker {
+
+	private:
+		struct TagStats {
+			std::atomic <size_t> _current {0};
+			std::atomic <size_t> _peak {0};
+			std::atomic <size_t> _allocations {0};
+			std::atomic <size_t> _failures {0};
+			std::atomic <bool> _overBudget {false};
+			size_t _budget = 0; // zero means unlimited
+			BudgetPolicy _policy = BudgetPolicy::Log;
+		};
+
+		TagStats _tags [SIM_MEMORY_NUM_TAGS];
+
+		// registered pools (guarded by _mutex)
+		std::mutex _mutex;
+		MemoryPool* _pools [SIM_MEMORY_MAX_TRACKED_POOLS] = {nullptr};
+		unsigned int _numPools = 0;
+
+		MemoryTracker () = default;
+
+	public:
+		static MemoryTracker& Instance ();
+
+		~MemoryTracker () = default;
+
+		MemoryTracker (const MemoryTracker&) = delete;
+		MemoryTracker& operator = (const MemoryTracker&) = delete;
+
+		/**
+		 * Charges 'bytes' to a tag. Returns false (and records nothing) if the
+		 * tag would exceed a budget with the Fail policy; the caller must then
+		 * release the memory and fail the allocation.
+		 */
+#		ifdef SIM_MEMORY_STATS_ENABLED
+		inline bool Allocate (MemoryTag tag, size_t bytes) {return Charge (tag, bytes);}
+		inline void Free (MemoryTag tag, size_t bytes) {_tags [Index (tag)]._current.fetch_sub (bytes, std::memory_order_relaxed);}
+#		else
+		inline bool Allocate (MemoryTag, size_t) {return true;}
+		inline void Free (MemoryTag, size_t) {}
+#		endif
+
+		// a zero budget removes the limit
+		void SetBudget (MemoryTag tag, size_t bytes, BudgetPolicy policy);
+
+		size_t Current (MemoryTag tag) const {return _tags [Index (tag)]._current.load (std::memory_order_relaxed);}
+		size_t Peak (MemoryTag tag) const {return _tags [Index (tag)]._peak.load (std::memory_order_relaxed);}
+		size_t Budget (MemoryTag tag) const {return _tags [Index (tag)]._budget;}
+		size_t Total () const;
+
+		void RegisterPool (MemoryPool* pool);
+		void UnregisterPool (MemoryPool* pool);
+
+		// logs the usage of every tag and the counters of every registered pool
+		void Report ();
+
+	private:
+		static unsigned int Index (MemoryTag tag) {return static_cast <unsigned int> (tag);}
+
+		bool Charge (MemoryTag tag, size_t bytes);
+	};
+}
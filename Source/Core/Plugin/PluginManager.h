@@ -15,6 +15,7 @@
 
 #include "tinyxml2.h"
 #include "Types.h"
+#include "Memory/Memory.h"
 
 namespace Sim {
 
@@ -24,8 +25,8 @@ namespace Sim {
 	class PluginManager {
 
 		protected:
-			std::map <PluginType, std::unique_ptr <SharedLib> > _libs;
-			std::map <PluginType, std::unique_ptr <Plugin> > _plugins;
+			PooledMap <PluginType, std::unique_ptr <SharedLib> > _libs;
+			PooledMap <PluginType, std::unique_ptr <Plugin> > _plugins;
 
 		public:
 			PluginManager () = default;
@@ -0,0 +1,153 @@
+/**
+ * @file IOExecutor.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See IOExecutor.h.
+ */
+
+#include <exception>
+#include <string>
+
+#include "Log.h"
+#include "ConfigParser.h"
+#include "Driver/Driver.h"
+#include "Tasks/IOExecutor.h"
+#include "Tasks/TaskManager.h"
+#include "Tasks/TaskProfiler.h"
+#include "Tasks/ThreadPlacement.h"
+
+using tinyxml2::XMLElement;
+using tinyxml2::XML_SUCCESS;
+
+namespace Sim {
+
+	bool IOExecutor::Initialize (TaskManager& compute, const char* config, const char* rootName, const std::vector <unsigned int>& cpus)
+	{
+		ConfigParser parser;
+		if (!parser.Initialize (config, rootName)){
+			LOG_ERROR ("Could not initialize parser for " << config);
+			return false;
+		}
+
+		// <IO Threads="2"/>
+		unsigned int threads = SIM_IO_DEFAULT_THREADS;
+		XMLElement* element = parser.GetRoot ()->FirstChildElement ("IO");
+		if (element != nullptr && element->Attribute ("Threads") != nullptr && element->QueryUnsignedAttribute ("Threads", &threads) != XML_SUCCESS){
+			LOG_ERROR ("Invalid \'Threads\' of IO in " << config);
+			return false;
+		}
+		return Initialize (compute, threads, cpus);
+	}
+
+	bool IOExecutor::Initialize (TaskManager& compute, unsigned int threads, const std::vector <unsigned int>& cpus)
+	{
+		Cleanup ();
+
+		_compute = &compute;
+		_cpus = cpus;
+		_running = true;
+		for (unsigned int i = 0; i < threads; ++i){
+			_threads.emplace_back (&IOExecutor::Run, this, i);
+		}
+		return true;
+	}
+
+	void IOExecutor::Cleanup ()
+	{
+		{
+			std::lock_guard <std::mutex> loki (_mutex);
+			// nobody waits on a prefetch: drop those not started, their futures get broken_promise
+			_queues [static_cast <unsigned int> (IOPriority::Prefetch)].clear ();
+			_running = false;
+			_wake.notify_all ();
+		}
+		for (auto& t : _threads){
+			t.join ();
+		}
+		_threads.clear ();
+		_compute = nullptr;
+	}
+
+	size_t IOExecutor::Pending () const
+	{
+		std::lock_guard <std::mutex> loki (_mutex);
+		size_t pending = 0;
+		for (auto& q : _queues){
+			pending += q.size ();
+		}
+		return pending;
+	}
+
+	void IOExecutor::Post (IOPriority priority, std::function <void ()> job)
+	{
+		{
+			std::lock_guard <std::mutex> loki (_mutex);
+			if (_running && !_threads.empty ()){
+				_queues [static_cast <unsigned int> (priority)].push_back (std::move (job));
+				_wake.notify_one ();
+				return;
+			}
+		}
+		// no I/O threads: the caller does the job
+		job ();
+	}
+
+	void IOExecutor::Continue (std::function <void ()> work)
+	{
+		if (_compute != nullptr){
+			_compute->Enqueue (std::move (work));
+		} else {
+			work ();
+		}
+	}
+
+	void IOExecutor::Run (unsigned int index)
+	{
+		TaskProfiler::Instance ().NameThread ("IO " + std::to_string (index));
+		// the I/O threads sleep on their reads: they share the processors of the driver thread
+		if (!_cpus.empty ()){
+			PinThread (_cpus);
+		}
+
+		EventManager* events = Driver::Instance ().GetEventManager ();
+		if (events != nullptr){
+			events->AttachThread ();
+		}
+
+		while (true){
+			std::function <void ()> job;
+			{
+				std::unique_lock <std::mutex> loki (_mutex);
+				_wake.wait (loki, [this] () {
+					return !_running || !_queues [0].empty () || !_queues [1].empty () || !_queues [2].empty ();
+				});
+				// the oldest job of the highest class, the queued ones are finished before stopping
+				for (auto& q : _queues){
+					if (!q.empty ()){
+						job = std::move (q.front ());
+						q.pop_front ();
+						break;
+					}
+				}
+				if (!job){
+					break;
+				}
+			}
+
+			try {
+				job ();
+			} catch (const std::exception& e){
+				LOG_ERROR ("I/O job failed: " << e.what ());
+			} catch (...){
+				LOG_ERROR ("I/O job failed");
+			}
+		}
+
+		if (events != nullptr){
+			events->DetachThread ();
+		}
+	}
+}
@@ -0,0 +1,113 @@
+/**
+ * @file IOExecutor.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * A few threads of the task manager that do blocking work (file reads
+ * etc.) so that the compute workers never block on it. Jobs are queued in
+ * three priority classes: Urgent (needed right away), Normal, and
+ * Prefetch (speculative, dropped on cleanup if not started). A free I/O
+ * thread takes the oldest job of the highest class. Submit () returns a
+ * shared_future of the job result and can hand that future, once ready,
+ * to a continuation that runs on the compute pool (TaskManager::Enqueue
+ * ()). The task config sets the number of I/O threads:
+ *
+ *   <IO Threads="2"/>
+ *
+ * With no threads (Threads="0", or before initialization), jobs run on
+ * the calling thread. When the threads of the task manager are placed,
+ * the I/O threads share the processors of the driver thread.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Sim {
+
+	class TaskManager;
+
+	const unsigned int SIM_IO_DEFAULT_THREADS = 2;
+
+	enum class IOPriority {
+		Urgent,
+		Normal,
+		Prefetch
+	};
+	const unsigned int SIM_IO_PRIORITIES = 3;
+
+	class IOExecutor {
+
+		private:
+			TaskManager* _compute = nullptr;
+			std::vector <std::thread> _threads;
+			std::vector <unsigned int> _cpus;
+
+			mutable std::mutex _mutex;
+			std::condition_variable _wake;
+			std::deque <std::function <void ()> > _queues [SIM_IO_PRIORITIES];
+			bool _running = false;
+
+		public:
+			IOExecutor () = default;
+			~IOExecutor () {Cleanup ();}
+
+			IOExecutor (const IOExecutor&) = delete;
+			IOExecutor& operator = (const IOExecutor&) = delete;
+
+			// starts the threads given by the IO element of the config, continuations go to 'compute'
+			bool Initialize (TaskManager& compute, const char* config, const char* rootName, const std::vector <unsigned int>& cpus);
+			bool Initialize (TaskManager& compute, unsigned int threads, const std::vector <unsigned int>& cpus);
+			// runs the queued jobs except prefetches and stops the threads
+			void Cleanup ();
+
+			bool IsRunning () const {return !_threads.empty ();}
+			// jobs queued and not started yet
+			size_t Pending () const;
+
+			// runs 'job' on an I/O thread
+			void Post (IOPriority priority, std::function <void ()> job);
+
+			// runs 'read' on an I/O thread, its result (or exception) comes through the future
+			template <class F> std::shared_future <typename std::result_of <F ()>::type> Submit (IOPriority priority, F&& read);
+			// same, and runs 'then' with the ready future on the compute pool
+			template <class F, class C> std::shared_future <typename std::result_of <F ()>::type> Submit (IOPriority priority, F&& read, C&& then);
+
+		private:
+			void Run (unsigned int index);
+			// hands 'work' to the compute pool
+			void Continue (std::function <void ()> work);
+	};
+
+	template <class F> std::shared_future <typename std::result_of <F ()>::type> IOExecutor::Submit (IOPriority priority, F&& read)
+	{
+		typedef typename std::result_of <F ()>::type Result;
+		auto job = std::make_shared <std::packaged_task <Result ()> > (std::forward <F> (read));
+		std::shared_future <Result> result = job->get_future ().share ();
+		Post (priority, [job] () {(*job) ();});
+		return result;
+	}
+
+	template <class F, class C> std::shared_future <typename std::result_of <F ()>::type> IOExecutor::Submit (IOPriority priority, F&& read, C&& then)
+	{
+		typedef typename std::result_of <F ()>::type Result;
+		auto job = std::make_shared <std::packaged_task <Result ()> > (std::forward <F> (read));
+		std::shared_future <Result> result = job->get_future ().share ();
+		std::function <void (std::shared_future <Result>)> continuation (std::forward <C> (then));
+		Post (priority, [this, job, result, continuation] () {
+			(*job) ();
+			Continue ([result, continuation] () {continuation (result);});
+		});
+		return result;
+	}
+}
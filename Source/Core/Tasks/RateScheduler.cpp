@@ -0,0 +1,320 @@
+/**
+ * @file RateScheduler.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See RateScheduler.h.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Log.h"
+#include "ConfigParser.h"
+#include "Driver/Driver.h"
+#include "Tasks/RateScheduler.h"
+#include "Tasks/TaskProfiler.h"
+#include "Tasks/ThreadPlacement.h"
+
+using std::chrono::steady_clock;
+using std::vector;
+using tinyxml2::XMLElement;
+using tinyxml2::XML_SUCCESS;
+
+namespace Sim {
+
+	namespace {
+		double Microseconds (steady_clock::duration d)
+		{
+			return std::chrono::duration <double, std::micro> (d).count ();
+		}
+
+		const unsigned int GeometryData = AssetData::CurrentGeometry | AssetData::PreviousGeometry | AssetData::PresentedGeometry;
+
+		// the presented geometry may be either buffer
+		unsigned int Expand (unsigned int data)
+		{
+			return data & static_cast <unsigned int> (AssetData::PresentedGeometry) ? data | AssetData::CurrentGeometry | AssetData::PreviousGeometry : data;
+		}
+
+		// data of 'asset' that 'task' reads or writes
+		unsigned int Touches (const GraphTask& task, AssetId asset)
+		{
+			if (task._asset == asset){
+				return Expand (task._access._reads | task._access._writes);
+			}
+			bool touches = task._touchesAll || std::find (task._touches.begin (), task._touches.end (), asset) != task._touches.end ();
+			return touches ? Expand (task._access._readsOthers) : 0;
+		}
+
+		// checks a lane update against the updates of another graph, false if two of them write the same data
+		bool CheckAccesses (const GraphTask& lane, const char* laneName, const TaskGraph& graph, const char* graphName)
+		{
+			bool valid = true;
+			for (size_t i = 0; i < graph.Size (); ++i){
+				const GraphTask& other = graph.Task (i);
+				if (other._target == lane._target){
+					LOG_WARNING (lane._name << " runs in lane " << laneName << " and in " << graphName);
+				}
+
+				unsigned int writes = lane._asset == other._asset ? Expand (lane._access._writes) & Expand (other._access._writes) : 0;
+				if (writes != 0){
+					LOG_ERROR (lane._name << " in lane " << laneName << " and " << other._name << " in " << graphName
+						<< " write the same data of " << lane._asset << " unsynchronized");
+					valid = false;
+				}
+				else if (Expand (lane._access._writes) & Touches (other, lane._asset)){
+					LOG_WARNING (other._name << " in " << graphName << " reads data of " << lane._asset << " that " << lane._name
+						<< " in lane " << laneName << " writes unsynchronized, it may see torn values");
+				}
+				else if (Expand (other._access._writes) & Touches (lane, other._asset)){
+					LOG_WARNING (lane._name << " in lane " << laneName << " reads data of " << other._asset << " that " << other._name
+						<< " in " << graphName << " writes unsynchronized, it may see torn values");
+				}
+			}
+			return valid;
+		}
+	}
+
+	double RateStats::JitterDeviation () const
+	{
+		return _ticks > 1 ? std::sqrt (_squaredJitter/(_ticks - 1)) : 0.0;
+	}
+
+	bool RateScheduler::Initialize (const char* config, const char* rootName, TaskGraph& frame)
+	{
+		Cleanup ();
+
+		ConfigParser parser;
+		if (!parser.Initialize (config, rootName)){
+			LOG_ERROR ("Could not initialize parser for " << config);
+			return false;
+		}
+
+		XMLElement* element = parser.GetRoot ()->FirstChildElement ("Lane");
+		while (element != nullptr){
+			_lanes.emplace_back (new Lane);
+			if (!Parse (*element, config, *_lanes.back ())){
+				Cleanup ();
+				return false;
+			}
+			element = element->NextSiblingElement ("Lane");
+		}
+
+		// the updates of a lane run unsynchronized with the frame and the other lanes
+		bool valid = true;
+		for (size_t i = 0; i < _lanes.size (); ++i){
+			const TaskGraph& tasks = _lanes [i]->_tasks;
+			const char* name = _lanes [i]->_name.c_str ();
+			for (size_t t = 0; t < tasks.Size (); ++t){
+				valid = CheckAccesses (tasks.Task (t), name, frame, "the frame") && valid;
+				for (size_t j = i + 1; j < _lanes.size (); ++j){
+					valid = CheckAccesses (tasks.Task (t), name, _lanes [j]->_tasks, _lanes [j]->_name.c_str ()) && valid;
+				}
+			}
+		}
+		if (!valid){
+			LOG_ERROR ("Lanes of " << config << " write data that other updates write");
+			Cleanup ();
+			return false;
+		}
+
+		// pipelined frames must not flip the buffers of a geometry under a lane
+		vector <AssetId> shared;
+		for (auto& lane : _lanes){
+			for (size_t t = 0; t < lane->_tasks.Size (); ++t){
+				for (size_t f = 0; f < frame.Size (); ++f){
+					AssetId asset = frame.Task (f)._asset;
+					if (Touches (lane->_tasks.Task (t), asset) & GeometryData){
+						shared.push_back (asset);
+					}
+				}
+			}
+		}
+		frame.KeepSequential (shared);
+
+		Start ();
+		return true;
+	}
+
+	void RateScheduler::Start ()
+	{
+		_running = true;
+		for (auto& lane : _lanes){
+			lane->_thread = std::thread (&RateScheduler::Run, this, std::ref (*lane));
+		}
+	}
+
+	void RateScheduler::Stop ()
+	{
+		_running = false;
+		for (auto& lane : _lanes){
+			if (lane->_thread.joinable ()){
+				lane->_thread.join ();
+			}
+		}
+	}
+
+	bool RateScheduler::IsStale () const
+	{
+		for (auto& lane : _lanes){
+			if (lane->_tasks.IsStale ()){
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void RateScheduler::Rebuild ()
+	{
+		// the lane threads must not run their graphs meanwhile
+		Stop ();
+		for (auto& lane : _lanes){
+			lane->_tasks.Rebuild ();
+		}
+		Start ();
+	}
+
+	bool RateScheduler::Parse (XMLElement& element, const char* config, Lane& lane)
+	{
+		// <Lane Name="Haptic" Hz="1000" [Policy="CatchUp|Drop"] [MaxSteps="4"] [Cpus="1"] [Fifo="80"]>
+		const char* name = element.Attribute ("Name");
+		if (name == nullptr){
+			LOG_ERROR ("Lane without \'Name\' in " << config);
+			return false;
+		}
+		lane._name = name;
+
+		if (element.QueryDoubleAttribute ("Hz", &lane._hz) != XML_SUCCESS || lane._hz <= 0.0){
+			LOG_ERROR ("Lane " << name << " needs a positive \'Hz\' in " << config);
+			return false;
+		}
+		lane._period = std::chrono::nanoseconds (static_cast <long long> (1.0e9/lane._hz));
+
+		const char* policy = element.Attribute ("Policy");
+		if (policy != nullptr && strcmp (policy, "CatchUp") && strcmp (policy, "Drop")){
+			LOG_ERROR ("Policy of lane " << name << " must be CatchUp or Drop");
+			return false;
+		}
+		lane._policy = policy != nullptr && !strcmp (policy, "Drop") ? RatePolicy::Drop : RatePolicy::CatchUp;
+
+		lane._maxSteps = lane._policy == RatePolicy::CatchUp ? 4 : 1;
+		element.QueryUnsignedAttribute ("MaxSteps", &lane._maxSteps);
+		if (lane._maxSteps == 0){
+			LOG_ERROR ("Lane " << name << " must run at least one step per tick");
+			return false;
+		}
+
+		const char* cpus = element.Attribute ("Cpus");
+		if (cpus != nullptr && !ParseCpuList (cpus, lane._cpus)){
+			LOG_ERROR ("Malformed Cpus \'" << cpus << "\' of lane " << name);
+			return false;
+		}
+		element.QueryIntAttribute ("Fifo", &lane._fifo);
+
+		if (!lane._tasks.Initialize (element, config)){
+			LOG_ERROR ("Could not read the tasks of lane " << name);
+			return false;
+		}
+		LOG ("Lane " << name << " runs " << lane._tasks.Size () << " updates at " << lane._hz << " Hz");
+		return true;
+	}
+
+	void RateScheduler::Cleanup ()
+	{
+		Stop ();
+		Report ();
+		_lanes.clear ();
+	}
+
+	bool RateScheduler::Stats (const char* name, RateStats& stats) const
+	{
+		for (auto& lane : _lanes){
+			if (lane->_name == name){
+				std::lock_guard <std::mutex> loki (lane->_statsMutex);
+				stats = lane->_stats;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void RateScheduler::Report () const
+	{
+		for (auto& lane : _lanes){
+			RateStats stats;
+			{
+				std::lock_guard <std::mutex> loki (lane->_statsMutex);
+				stats = lane->_stats;
+			}
+			if (stats._ticks == 0){
+				continue;
+			}
+			LOG ("Lane " << lane->_name << " at " << lane->_hz << " Hz: " << stats._steps << " steps, " << stats._dropped << " dropped, "
+				<< stats._overruns << " overruns, step " << stats._meanStep << " us, jitter " << stats._meanJitter << " us (deviation "
+				<< stats.JitterDeviation () << " us, max " << stats._maxJitter << " us)");
+		}
+	}
+
+	void RateScheduler::Run (Lane& lane)
+	{
+		TaskProfiler::Instance ().NameThread ("Lane " + lane._name);
+		if (!lane._cpus.empty ()){
+			PinThread (lane._cpus);
+		}
+		if (lane._fifo > 0){
+			SetRealtimePriority (lane._fifo);
+		}
+
+		// events raised by the lane go to its own outbox
+		EventManager* events = Driver::Instance ().GetEventManager ();
+		if (events != nullptr){
+			events->AttachThread ();
+		}
+
+		steady_clock::time_point next = steady_clock::now () + lane._period;
+		while (_running){
+			// sleep, then spin the last stretch for a punctual start
+			if (next - steady_clock::now () > SIM_RATE_SPIN_TIME){
+				std::this_thread::sleep_until (next - SIM_RATE_SPIN_TIME);
+			}
+			while (steady_clock::now () < next && _running){
+				std::this_thread::yield ();
+			}
+			if (!_running){
+				break;
+			}
+
+			// steps due since the last tick, the late ones are caught up or dropped
+			steady_clock::time_point start = steady_clock::now ();
+			unsigned long long due = 1 + (start - next)/lane._period;
+			unsigned long long steps = lane._policy == RatePolicy::CatchUp ? std::min <unsigned long long> (due, lane._maxSteps) : 1;
+			for (unsigned long long i = 0; i < steps; ++i){
+				lane._tasks.RunSerial ();
+			}
+			steady_clock::time_point end = steady_clock::now ();
+
+			double jitter = Microseconds (start - next);
+			next += due*lane._period;
+
+			std::lock_guard <std::mutex> loki (lane._statsMutex);
+			RateStats& stats = lane._stats;
+			++stats._ticks;
+			stats._steps += steps;
+			stats._dropped += due - steps;
+			stats._overruns += end > next ? 1 : 0;
+			double delta = jitter - stats._meanJitter;
+			stats._meanJitter += delta/stats._ticks;
+			stats._squaredJitter += delta*(jitter - stats._meanJitter);
+			stats._maxJitter = std::max (stats._maxJitter, jitter);
+			stats._meanStep += (Microseconds (end - start)/steps - stats._meanStep)/stats._ticks;
+		}
+
+		if (events != nullptr){
+			events->DetachThread ();
+		}
+	}
+}
@@ -0,0 +1,127 @@
+/**
+ * @file RateScheduler.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Runs task groups at their own fixed rates, next to the frame driven by
+ * the driver loop (haptics at 1 kHz, physics at a few hundred Hz etc.).
+ * Each Lane element of the task config holds Tasks like the root does and
+ * declares its rate:
+ *
+ *   <Lane Name="Haptic" Hz="1000" Policy="CatchUp" MaxSteps="4">
+ *     <Task Index="1" Type="Serial"> ... </Task>
+ *   </Lane>
+ *
+ * Every lane has a thread of its own and runs its graph once per step of
+ * 1/Hz seconds, so a lane never waits on the frame or on another lane.
+ * When a lane falls behind, CatchUp runs the missed steps back to back
+ * (up to MaxSteps per tick) and Drop skips them; steps beyond the limit
+ * are dropped either way. The scheduler keeps per-lane statistics of the
+ * start jitter, dropped steps and overruns, and logs them on cleanup.
+ * Lanes do not synchronize the data of their components with the frame
+ * or with each other: a component should run in one lane only and share
+ * its results through events. The scheduler checks the data accesses of
+ * the updates (Component::Access ()) per asset: lanes whose updates write
+ * data that the frame or another lane writes are rejected, and reads of
+ * data written elsewhere are warned about, as they may see torn values.
+ * Assets whose geometry a lane uses keep sequential frames in the frame
+ * graph, so that pipelined frames do not flip their buffers.
+ * Cpus="1" binds the thread of a lane to processors reserved for it (the
+ * workers keep off them, see Tasks/ThreadPlacement.h), and Fifo="80" runs
+ * it with that SCHED_FIFO priority, so a haptic lane is not preempted by
+ * the workers. Both are optional. When the assets change, the task
+ * manager has the lanes stopped, their graphs rebuilt and restarted.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Tasks/TaskGraph.h"
+
+namespace Sim {
+
+	// time a lane spins (instead of sleeping) before its next step
+	const std::chrono::microseconds SIM_RATE_SPIN_TIME (100);
+
+	enum class RatePolicy {
+		CatchUp,
+		Drop
+	};
+
+	struct RateStats {
+		unsigned long long _ticks = 0;
+		unsigned long long _steps = 0;
+		unsigned long long _dropped = 0;
+		// ticks that ended after the next one was due
+		unsigned long long _overruns = 0;
+
+		// lateness of the tick start in microseconds (running mean and squared deviations)
+		double _meanJitter = 0.0;
+		double _squaredJitter = 0.0;
+		double _maxJitter = 0.0;
+		// time taken by one step in microseconds
+		double _meanStep = 0.0;
+
+		double JitterDeviation () const;
+	};
+
+	class RateScheduler {
+
+		private:
+			struct Lane {
+				std::string _name;
+				double _hz = 0.0;
+				std::chrono::nanoseconds _period {0};
+				RatePolicy _policy = RatePolicy::CatchUp;
+				unsigned int _maxSteps = 1;
+				// processors the lane thread is bound to, and its SCHED_FIFO priority (0 for none)
+				std::vector <unsigned int> _cpus;
+				int _fifo = 0;
+
+				TaskGraph _tasks;
+				std::thread _thread;
+
+				mutable std::mutex _statsMutex;
+				RateStats _stats;
+			};
+
+			std::vector <std::unique_ptr <Lane> > _lanes;
+			std::atomic <bool> _running {false};
+
+		public:
+			RateScheduler () = default;
+			~RateScheduler () {Cleanup ();}
+
+			RateScheduler (const RateScheduler&) = delete;
+			RateScheduler& operator = (const RateScheduler&) = delete;
+
+			// reads the lanes of the config, checks them against 'frame' (the graph of the driver loop) and starts them
+			bool Initialize (const char* config, const char* rootName, TaskGraph& frame);
+			// stops the lanes and reports their statistics
+			void Cleanup ();
+
+			// true once the assets changed since the lane graphs were built
+			bool IsStale () const;
+			// stops the lanes, rebuilds their graphs and starts them again. From the driver thread
+			void Rebuild ();
+
+			size_t Size () const {return _lanes.size ();}
+			// statistics of the named lane so far, false if there is none
+			bool Stats (const char* name, RateStats& stats) const;
+			void Report () const;
+
+		private:
+			bool Parse (tinyxml2::XMLElement&, const char* config, Lane&);
+			void Start ();
+			void Stop ();
+			void Run (Lane&);
+	};
+}
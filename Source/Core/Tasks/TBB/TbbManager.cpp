@@ -0,0 +1,215 @@
+/**
+ * @file TbbManager.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See TbbManager.h.
+ */
+
+#include <cassert>
+
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+
+#include "Log.h"
+#include "Driver/Driver.h"
+#include "Tasks/TaskProfiler.h"
+#include "Tasks/TBB/TbbManager.h"
+
+using tbb::flow::continue_msg;
+
+namespace Sim {
+
+	namespace {
+		// observer that pinned the calling worker, so a worker rejoining the scheduler keeps its processor
+		thread_local const WorkerObserver* pinnedBy = nullptr;
+	}
+
+	void WorkerObserver::on_scheduler_entry (bool worker)
+	{
+		if (worker && _placement.IsPinned () && pinnedBy != this){
+			PinThread (_placement.WorkerCpus (_next++));
+			pinnedBy = this;
+		}
+		// events raised by the component updates go to the outbox of the thread
+		EventManager* events = Driver::Instance ().GetEventManager ();
+		if (events != nullptr){
+			events->AttachThread ();
+		}
+	}
+
+	void WorkerObserver::on_scheduler_exit (bool worker)
+	{
+		EventManager* events = Driver::Instance ().GetEventManager ();
+		if (events != nullptr){
+			events->DetachThread ();
+		}
+	}
+
+	TbbManager::~TbbManager () {Cleanup ();}
+
+	bool TbbManager::Initialize (const char* config)
+	{
+		if (!_tasks.Initialize (config, "TBBConfig")){
+			LOG_ERROR ("Could not read task graph from " << config);
+			return false;
+		}
+
+		if (!_placement.Initialize (config, "TBBConfig")){
+			LOG_ERROR ("Could not read the thread placement of " << config);
+			return false;
+		}
+		if (_placement.IsPinned ()){
+			// the calling thread, and one worker per processor of the workers
+			_init.reset (new tbb::task_scheduler_init (static_cast <int> (_placement._workers.size ()) + 1));
+			if (!_placement._main.empty ()){
+				PinThread (_placement._main);
+			}
+		}
+		_observer.reset (new WorkerObserver (_placement));
+		_observer->observe (true);
+
+		if (!TaskProfiler::Instance ().Initialize (config, "TBBConfig")){
+			LOG_ERROR ("Could not start the task profiler of " << config);
+			Cleanup ();
+			return false;
+		}
+		if (!_rates.Initialize (config, "TBBConfig", _tasks)){
+			LOG_ERROR ("Could not start the task lanes of " << config);
+			Cleanup ();
+			return false;
+		}
+		// after the lanes, which may keep frames of the graph sequential
+		Compile ();
+		_background.reset (new tbb::task_group);
+		if (!_io.Initialize (*this, config, "TBBConfig", _placement._main)){
+			LOG_ERROR ("Could not start the I/O threads of " << config);
+			Cleanup ();
+			return false;
+		}
+
+		LOG ("TBB task manager initialized with " << _nodes.size () << " flow graph nodes");
+		return true;
+	}
+
+	void TbbManager::Compile ()
+	{
+		_nodes.clear ();
+		_start.reset ();
+		_graph.reset (new tbb::flow::graph);
+		_start.reset (new tbb::flow::broadcast_node <continue_msg> (*_graph));
+
+		for (size_t i = 0; i < _tasks.Size (); ++i){
+			_nodes.emplace_back (new Node (*_graph, [this, i] (const continue_msg&) {
+				AllocationScope scope (_allocations);
+				_tasks.Run (i);
+			}));
+			const GraphTask& task = _tasks.Task (i);
+			if (task._predecessors.empty ()){
+				tbb::flow::make_edge (*_start, *_nodes.back ());
+			}
+			// predecessors come first in the graph
+			for (size_t p : task._predecessors){
+				tbb::flow::make_edge (*_nodes [p], *_nodes.back ());
+			}
+		}
+		_steadyFrames = 0;
+	}
+
+	void TbbManager::Update ()
+	{
+		if (!_graph){
+			return;
+		}
+		if (_tasks.IsStale ()){
+			// between frames: the flow graph is idle
+			_tasks.Rebuild ();
+			Compile ();
+		}
+		if (_rates.IsStale ()){
+			_rates.Rebuild ();
+		}
+		TaskProfiler& profiler = TaskProfiler::Instance ();
+		bool profiling = profiler.IsEnabled ();
+		long long start = profiling ? profiler.Now () : 0;
+
+		{
+			AllocationScope scope (_allocations);
+			_start->try_put (continue_msg ());
+			_graph->wait_for_all ();
+		}
+		_tasks.EndFrame ();
+
+#		ifndef NDEBUG
+		// the profiler allocates its buffers as threads first record
+		if (++_steadyFrames > SIM_TASK_WARMUP_FRAMES && !profiling && _allocations.Count () > 0){
+			LOG_ERROR (_allocations.Count () << " heap allocations in steady-state frame " << _steadyFrames);
+			assert (_allocations.Count () == 0);
+		}
+		_allocations.Reset ();
+#		endif
+
+		if (profiling){
+			profiler.EndFrame (start, _tasks);
+		}
+	}
+
+	void TbbManager::ParallelFor (size_t begin, size_t end, const RangeTask& task, size_t grain)
+	{
+		if (begin >= end){
+			return;
+		}
+		// with no grain given, the auto partitioner splits on demand
+		tbb::parallel_for (tbb::blocked_range <size_t> (begin, end, grain > 0 ? grain : 1), [&task] (const tbb::blocked_range <size_t>& r) {
+			task (r.begin (), r.end ());
+		});
+	}
+
+	unsigned int TbbManager::Concurrency () const
+	{
+		return _init ? static_cast <unsigned int> (_placement._workers.size ()) + 1 : static_cast <unsigned int> (tbb::task_scheduler_init::default_num_threads ());
+	}
+
+	void TbbManager::Enqueue (std::function <void ()> work)
+	{
+		if (!_background){
+			work ();
+			return;
+		}
+		// not part of the frame, even when a worker takes it up while waiting on one
+		_background->run ([work] () {
+			AllocationScope uncounted;
+			work ();
+		});
+	}
+
+	void TbbManager::Cleanup ()
+	{
+		// the trace refers to the task names of the graphs
+		TaskProfiler::Instance ().Stop (&_tasks);
+		_rates.Cleanup ();
+		// the last I/O jobs may still enqueue their continuations
+		_io.Cleanup ();
+		if (_background){
+			_background->wait ();
+			_background.reset ();
+		}
+		if (_graph){
+			_graph->wait_for_all ();
+		}
+		_nodes.clear ();
+		_start.reset ();
+		_graph.reset ();
+		_tasks.Cleanup ();
+
+		_observer.reset ();
+		if (_init){
+			_init.reset ();
+			if (!_placement._main.empty ()){
+				PinThread (std::vector <unsigned int> ());
+			}
+		}
+	}
+}
@@ -0,0 +1,99 @@
+/**
+ * @file TbbManager.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * The Intel TBB task manager. The task graph in TbbConfig.xml is turned
+ * into a tbb::flow graph once, at initialization. Every component update
+ * is a continue_node with an edge from each of its dependencies, and the
+ * updates without any hang off a start node. Update () then runs the
+ * whole frame with a single try_put on the start node, and rebuilds the
+ * flow graph first when the assets changed. Debug builds check that
+ * steady-state frames do not allocate. Lanes with rates of their own run
+ * next to it (see Tasks/RateScheduler.h). An observer gives each thread
+ * that joins the scheduler its own event outbox. With a Threads element
+ * in the config (see Tasks/ThreadPlacement.h), the scheduler gets one
+ * worker per processor of the workers, the observer also pins each
+ * worker as it joins, and the calling thread is pinned to its own
+ * processors.
+ * Blocking jobs go to the I/O threads (see Tasks/IOExecutor.h), whose
+ * continuations come back as background tasks of a tbb::task_group.
+ */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "tbb/flow_graph.h"
+#include "tbb/task_group.h"
+#include "tbb/task_scheduler_init.h"
+#include "tbb/task_scheduler_observer.h"
+
+#include "Memory/AllocationCounter.h"
+#include "Tasks/TaskManager.h"
+#include "Tasks/TaskGraph.h"
+#include "Tasks/RateScheduler.h"
+#include "Tasks/ThreadPlacement.h"
+
+namespace Sim {
+
+	// attaches the threads joining the scheduler to the event manager, and pins the workers of a placement
+	class WorkerObserver : public tbb::task_scheduler_observer {
+
+		private:
+			const ThreadPlacement& _placement;
+			std::atomic <unsigned int> _next {0};
+
+		public:
+			explicit WorkerObserver (const ThreadPlacement& placement): _placement (placement) {}
+			~WorkerObserver () {observe (false);}
+
+			void on_scheduler_entry (bool worker) override;
+			void on_scheduler_exit (bool worker) override;
+	};
+
+	class TbbManager : public TaskManager {
+
+		private:
+			typedef tbb::flow::continue_node <tbb::flow::continue_msg> Node;
+
+			ThreadPlacement _placement;
+			std::unique_ptr <tbb::task_scheduler_init> _init;
+			std::unique_ptr <WorkerObserver> _observer;
+
+			TaskGraph _tasks;
+			// lanes running at their own rates, next to the frame
+			RateScheduler _rates;
+			std::unique_ptr <tbb::flow::graph> _graph;
+			std::unique_ptr <tbb::flow::broadcast_node <tbb::flow::continue_msg> > _start;
+			std::vector <std::unique_ptr <Node> > _nodes;
+			// tasks enqueued from outside the frame, continuations of I/O jobs etc.
+			std::unique_ptr <tbb::task_group> _background;
+
+			// heap allocations of the frame, and frames since the flow graph was built
+			AllocationCounter _allocations;
+			unsigned int _steadyFrames = 0;
+
+		public:
+			TbbManager () = default;
+			~TbbManager ();
+
+			TbbManager (const TbbManager&) = delete;
+			TbbManager& operator = (const TbbManager&) = delete;
+
+			bool Initialize (const char* config) override;
+			void Update () override;
+			void Cleanup () override;
+			void ParallelFor (size_t begin, size_t end, const RangeTask& task, size_t grain = 0) override;
+			bool LaneStats (const char* name, RateStats& stats) const override {return _rates.Stats (name, stats);}
+			unsigned int Concurrency () const override;
+			void Enqueue (std::function <void ()> work) override;
+
+		private:
+			// turns the task graph into the flow graph
+			void Compile ();
+	};
+}
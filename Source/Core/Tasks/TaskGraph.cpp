@@ -0,0 +1,599 @@
+/**
+ * @file TaskGraph.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See TaskGraph.h.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "Log.h"
+#include "ConfigParser.h"
+#include "Driver/Driver.h"
+#include "Asset/Asset.h"
+#include "Tasks/TaskGraph.h"
+#include "Tasks/TaskProfiler.h"
+#include "Tasks/WorkPartition.h"
+
+using std::pair;
+using std::vector;
+using tinyxml2::XMLElement;
+using tinyxml2::XML_SUCCESS;
+
+namespace Sim {
+
+	namespace {
+		bool ParseOrder (XMLElement& element, TaskOrder& order)
+		{
+			const char* type = element.Attribute ("Type");
+			if (type == nullptr || (strcmp (type, "Parallel") && strcmp (type, "Serial"))){
+				LOG_ERROR ("Task type must be Parallel or Serial");
+				return false;
+			}
+			order = strcmp (type, "Parallel") ? TaskOrder::Serial : TaskOrder::Parallel;
+			return true;
+		}
+
+		// last writer and readers since of one kind of data of one asset
+		struct DataState {
+			size_t _writer = SIZE_MAX;
+			vector <size_t> _readers;
+		};
+	}
+
+	bool TaskGraph::Initialize (const char* config, const char* rootName)
+	{
+		ConfigParser parser;
+		if (!parser.Initialize (config, rootName)){
+			LOG_ERROR ("Could not initialize parser for " << config);
+			return false;
+		}
+		return Initialize (*parser.GetRoot (), config);
+	}
+
+	bool TaskGraph::Initialize (XMLElement& root, const char* config)
+	{
+		XMLElement* element = root.FirstChildElement ("Task");
+		if (element == nullptr){
+			LOG_ERROR ("No tasks specified in " << config);
+			return false;
+		}
+
+		// <TBBConfig Dependencies="Config|Inferred">
+		const char* mode = root.Attribute ("Dependencies");
+		if (mode != nullptr && strcmp (mode, "Config") && strcmp (mode, "Inferred")){
+			LOG_ERROR ("Dependencies must be Config or Inferred in " << config);
+			return false;
+		}
+		_inferred = mode != nullptr && !strcmp (mode, "Inferred");
+
+		// <TBBConfig Frames="Sequential|Pipelined">
+		mode = root.Attribute ("Frames");
+		if (mode != nullptr && strcmp (mode, "Sequential") && strcmp (mode, "Pipelined")){
+			LOG_ERROR ("Frames must be Sequential or Pipelined in " << config);
+			return false;
+		}
+		_pipelined = mode != nullptr && !strcmp (mode, "Pipelined");
+		if (_pipelined && !_inferred){
+			LOG_WARNING ("Pipelined frames only overlap the tasks the config runs in parallel");
+		}
+
+		_stages.clear ();
+		while (element != nullptr){
+			unsigned int index = 0;
+			if (element->QueryUnsignedAttribute ("Index", &index) != XML_SUCCESS){
+				LOG_ERROR ("Task without \'Index\' in " << config);
+				Cleanup ();
+				return false;
+			}
+			for (auto& s : _stages){
+				if (s.first == index){
+					LOG_ERROR ("Duplicate task index " << index << " in " << config);
+					Cleanup ();
+					return false;
+				}
+			}
+
+			TaskNode node;
+			if (!Parse (*element, AssetComponentType::Unknown, node)){
+				LOG_ERROR ("Could not read task " << index << " in " << config);
+				Cleanup ();
+				return false;
+			}
+			_stages.emplace_back (index, std::move (node));
+			element = element->NextSiblingElement ("Task");
+		}
+
+		std::sort (_stages.begin (), _stages.end (), [] (const pair <unsigned int, TaskNode>& a, const pair <unsigned int, TaskNode>& b) {
+			return a.first < b.first;
+		});
+		_source = config;
+		return Build (std::map <std::string, double> ());
+	}
+
+	bool TaskGraph::Build (const std::map <std::string, double>& costs)
+	{
+		_structure = Driver::Instance ().AssetStructure ();
+
+		// the leaves whose asset or component is missing are dropped from a copy
+		vector <pair <unsigned int, TaskNode> > stages;
+		for (auto& s : _stages){
+			TaskNode node (s.second);
+			if (Bind (node)){
+				stages.emplace_back (s.first, std::move (node));
+			}
+		}
+
+		for (auto& s : stages){
+			Flatten (s.second);
+		}
+		if (_inferred){
+			LinkAccesses ();
+		}
+		else {
+			// stages run one after another
+			size_t next = 0;
+			vector <size_t> before, after;
+			for (auto& s : stages){
+				LinkStructure (s.second, next, before, after);
+				before.swap (after);
+			}
+		}
+		Reduce ();
+		if (_pipelined){
+			BindGeometries ();
+		}
+		for (GraphTask& task : _tasks){
+			auto cost = costs.find (task._name);
+			if (cost != costs.end ()){
+				task._cost = cost->second;
+			}
+		}
+
+		LOG ("Task graph of " << _tasks.size () << " component updates and " << _edges << (_inferred ? " inferred" : "") << " dependencies read from " << _source << (_pipelined ? " (pipelined frames)" : ""));
+		ReportCriticalPath ();
+		return true;
+	}
+
+	bool TaskGraph::IsStale () const
+	{
+		return !_stages.empty () && _structure != Driver::Instance ().AssetStructure ();
+	}
+
+	bool TaskGraph::Rebuild ()
+	{
+		LOG ("Assets changed, rebuilding the task graph of " << _source);
+		return Relink ();
+	}
+
+	bool TaskGraph::Relink ()
+	{
+		std::map <std::string, double> costs;
+		for (const GraphTask& task : _tasks){
+			costs [task._name] = task._cost;
+		}
+
+		for (auto& geometry : _geometries){
+			geometry->SetPipelined (false);
+		}
+		_geometries.clear ();
+		_tasks.clear ();
+		_roots.clear ();
+		_edges = 0;
+		_frame = 0;
+		return Build (costs);
+	}
+
+	void TaskGraph::KeepSequential (const vector <AssetId>& assets)
+	{
+		vector <AssetId> sequential (assets);
+		std::sort (sequential.begin (), sequential.end ());
+		sequential.erase (std::unique (sequential.begin (), sequential.end ()), sequential.end ());
+		if (sequential == _sequential){
+			return;
+		}
+		_sequential.swap (sequential);
+
+		if (_pipelined && !_stages.empty ()){
+			LOG ("Frames of " << _sequential.size () << " assets stay sequential in " << _source << ", the lanes use their geometry");
+			Relink ();
+		}
+	}
+
+	bool TaskGraph::IsPipelined (AssetId asset) const
+	{
+		return _pipelined && !std::binary_search (_sequential.begin (), _sequential.end (), asset);
+	}
+
+	void TaskGraph::Cleanup ()
+	{
+		for (auto& geometry : _geometries){
+			geometry->SetPipelined (false);
+		}
+		_geometries.clear ();
+		_sequential.clear ();
+		_pipelined = false;
+		_tasks.clear ();
+		_roots.clear ();
+		_edges = 0;
+		_frame = 0;
+		_stages.clear ();
+		_source.clear ();
+	}
+
+	void TaskGraph::Run (size_t index)
+	{
+		GraphTask& task = _tasks [index];
+		// the events of the update are ordered by task, whichever thread runs it
+		EventManager::SetProducer (static_cast <unsigned short> (index + 1));
+		auto start = std::chrono::steady_clock::now ();
+		task._target->Update ();
+		auto end = std::chrono::steady_clock::now ();
+		EventManager::SetProducer (0);
+		double time = std::chrono::duration <double, std::micro> (end - start).count ();
+		task._cost = task._cost > 0.0 ? task._cost + SIM_TASK_COST_SMOOTHING*(time - task._cost) : time;
+
+		TaskProfiler& profiler = TaskProfiler::Instance ();
+		if (profiler.IsEnabled ()){
+			long long finish = profiler.Now ();
+			profiler.Record (TraceType::Task, task._name.c_str (), finish - static_cast <long long> (time*1000.0), finish);
+		}
+	}
+
+	void TaskGraph::EndFrame ()
+	{
+		// nothing runs at this point: the finished frame becomes the presented one
+		for (auto& geometry : _geometries){
+			geometry->Update ();
+		}
+		if (++_frame == SIM_TASK_COST_FRAMES){
+			ReportCriticalPath ();
+		}
+	}
+
+	void TaskGraph::RunSerial ()
+	{
+		for (size_t i = 0; i < _tasks.size (); ++i){
+			Run (i);
+		}
+		EndFrame ();
+	}
+
+	double TaskGraph::CriticalPath (vector <size_t>* path) const
+	{
+		if (_tasks.empty ()){
+			return 0.0;
+		}
+
+		// longest path ending at each task, in topological order
+		bool measured = _tasks.front ()._cost > 0.0;
+		vector <double> length (_tasks.size ());
+		vector <size_t> previous (_tasks.size (), SIZE_MAX);
+		size_t last = 0;
+		for (size_t i = 0; i < _tasks.size (); ++i){
+			double longest = 0.0;
+			for (size_t p : _tasks [i]._predecessors){
+				if (length [p] > longest){
+					longest = length [p];
+					previous [i] = p;
+				}
+			}
+			length [i] = longest + (measured ? _tasks [i]._cost : 1.0);
+			if (length [i] > length [last]){
+				last = i;
+			}
+		}
+
+		if (path != nullptr){
+			path->clear ();
+			for (size_t i = last; i != SIZE_MAX; i = previous [i]){
+				path->push_back (i);
+			}
+			std::reverse (path->begin (), path->end ());
+		}
+		return length [last];
+	}
+
+	void TaskGraph::ReportCriticalPath () const
+	{
+#		ifdef SIM_LOG_ENABLED
+		if (_tasks.empty ()){
+			return;
+		}
+
+		vector <size_t> path;
+		double length = CriticalPath (&path);
+		std::ostringstream chain;
+		for (size_t i = 0; i < path.size (); ++i){
+			chain << (i == 0 ? "" : " -> ") << _tasks [path [i]]._name;
+		}
+
+		if (_tasks.front ()._cost > 0.0){
+			double total = 0.0;
+			for (const GraphTask& task : _tasks){
+				total += task._cost;
+			}
+			LOG ("Critical path of " << length << " us out of " << total << " us of updates: " << chain.str ());
+		}
+		else {
+			LOG ("Critical path of " << path.size () << " out of " << _tasks.size () << " updates: " << chain.str ());
+		}
+#		endif
+	}
+
+	bool TaskGraph::Parse (XMLElement& element, AssetComponentType component, TaskNode& node)
+	{
+		const char* name = element.Attribute ("Component");
+		if (name != nullptr){
+			component = AssetComponentTypeByName (name);
+			if (component == AssetComponentType::Unknown){
+				LOG_ERROR ("Unknown component " << name);
+				return false;
+			}
+		}
+
+		// <Asset Name="Liver" [Component="Physics"] [Touches="Scalpel Retractor"]/>
+		if (!strcmp (element.Value (), "Asset")){
+			name = element.Attribute ("Name");
+			node._asset = name ? AssetIdByName (name) : AssetId::Unknown;
+			if (node._asset == AssetId::Unknown){
+				LOG_ERROR ("Unknown asset " << (name ? name : "(none)"));
+				return false;
+			}
+			if (component == AssetComponentType::Unknown){
+				LOG_ERROR ("No component given for " << name);
+				return false;
+			}
+			node._component = component;
+
+			const char* touches = element.Attribute ("Touches");
+			if (touches != nullptr){
+				node._touchesAll = false;
+				std::istringstream list (touches);
+				std::string other;
+				while (list >> other){
+					AssetId id = AssetIdByName (other.c_str ());
+					if (id == AssetId::Unknown){
+						LOG_ERROR ("Unknown asset " << other << " touched by " << name);
+						return false;
+					}
+					node._touches.push_back (id);
+				}
+			}
+			return true;
+		}
+
+		// <Task Type=".."> or <SubTask Type="..">
+		if (!ParseOrder (element, node._order)){
+			return false;
+		}
+		XMLElement* child = element.FirstChildElement ();
+		while (child != nullptr){
+			if (strcmp (child->Value (), "Asset") && strcmp (child->Value (), "SubTask")){
+				LOG_ERROR ("Unexpected element " << child->Value () << " in task");
+				return false;
+			}
+			node._children.emplace_back ();
+			if (!Parse (*child, component, node._children.back ())){
+				return false;
+			}
+			child = child->NextSiblingElement ();
+		}
+		return true;
+	}
+
+	bool TaskGraph::Bind (TaskNode& node)
+	{
+		if (node.IsLeaf ()){
+			std::shared_ptr <Asset> asset = Driver::Instance ().GetAsset (node._asset);
+			if (!asset || !asset->Has (node._component)){
+				LOG_WARNING (node._asset << " has no " << node._component << " component, task skipped");
+				return false;
+			}
+			// a second flip would undo the one of EndFrame ()
+			if (node._component == AssetComponentType::Geometry && IsPipelined (node._asset)){
+				LOG_WARNING ("Geometry update of " << node._asset << " skipped, pipelined frames flip its buffers at the end of the frame");
+				return false;
+			}
+			node._target = asset->Get <Assets::Component> (node._component);
+			return true;
+		}
+
+		// drop the children that cannot run, and the node if none is left
+		vector <TaskNode> children;
+		for (TaskNode& child : node._children){
+			if (Bind (child)){
+				children.push_back (std::move (child));
+			}
+		}
+		node._children.swap (children);
+		return !node._children.empty ();
+	}
+
+	void TaskGraph::Flatten (const TaskNode& node)
+	{
+		if (node.IsLeaf ()){
+			_tasks.emplace_back ();
+			GraphTask& task = _tasks.back ();
+			task._asset = node._asset;
+			task._component = node._component;
+			task._target = node._target;
+			std::ostringstream name;
+			name << node._asset << "/" << node._component;
+			task._name = name.str ();
+			task._access = node._target->Access ();
+			task._touchesAll = node._touchesAll;
+			task._touches = node._touches;
+			return;
+		}
+		for (const TaskNode& child : node._children){
+			Flatten (child);
+		}
+	}
+
+	void TaskGraph::LinkStructure (const TaskNode& node, size_t& next, const vector <size_t>& before, vector <size_t>& after)
+	{
+		after.clear ();
+		if (node.IsLeaf ()){
+			for (size_t b : before){
+				Link (b, next);
+			}
+			after.push_back (next++);
+			return;
+		}
+
+		vector <size_t> current (before), finished;
+		for (const TaskNode& child : node._children){
+			LinkStructure (child, next, node._order == TaskOrder::Serial ? current : before, finished);
+			if (node._order == TaskOrder::Serial){
+				current.swap (finished);
+			}
+			else {
+				after.insert (after.end (), finished.begin (), finished.end ());
+			}
+		}
+		if (node._order == TaskOrder::Serial){
+			after.swap (current);
+		}
+	}
+
+	void TaskGraph::LinkAccesses ()
+	{
+		vector <AssetId> assets;
+		for (const GraphTask& task : _tasks){
+			if (std::find (assets.begin (), assets.end (), task._asset) == assets.end ()){
+				assets.push_back (task._asset);
+			}
+		}
+
+		// the presented geometry is the current one, or the previous one when the asset is pipelined
+		unsigned int presented = static_cast <unsigned int> (AssetData::PresentedGeometry);
+		auto resolve = [=] (unsigned int bits, AssetId asset) {
+			unsigned int geometry = static_cast <unsigned int> (IsPipelined (asset) ? AssetData::PreviousGeometry : AssetData::CurrentGeometry);
+			return bits & presented ? (bits & ~presented) | geometry : bits;
+		};
+
+		std::map <pair <AssetId, unsigned int>, DataState> states;
+		for (size_t i = 0; i < _tasks.size (); ++i){
+			DataAccess access = _tasks [i]._access;
+			access._reads = resolve (access._reads, _tasks [i]._asset);
+			access._writes = resolve (access._writes, _tasks [i]._asset);
+			const vector <AssetId>& others = _tasks [i]._touchesAll ? assets : _tasks [i]._touches;
+
+			for (unsigned int k = 0; k < SIM_ASSET_DATA_KINDS; ++k){
+				unsigned int bit = 1u << k;
+
+				// reads see the last write
+				auto read = [&] (AssetId asset) {
+					DataState& state = states [std::make_pair (asset, bit)];
+					if (state._writer != SIZE_MAX){
+						Link (state._writer, i);
+					}
+					state._readers.push_back (i);
+				};
+				if (access._reads & bit){
+					read (_tasks [i]._asset);
+				}
+				for (AssetId other : others){
+					if (other != _tasks [i]._asset && resolve (access._readsOthers, other) & bit){
+						read (other);
+					}
+				}
+
+				// writes wait for the last write and the reads since
+				if (access._writes & bit){
+					DataState& state = states [std::make_pair (_tasks [i]._asset, bit)];
+					if (state._writer != SIZE_MAX){
+						Link (state._writer, i);
+					}
+					for (size_t r : state._readers){
+						Link (r, i);
+					}
+					state._writer = i;
+					state._readers.clear ();
+				}
+			}
+		}
+	}
+
+	void TaskGraph::BindGeometries ()
+	{
+		for (const GraphTask& task : _tasks){
+			std::shared_ptr <Asset> asset = Driver::Instance ().GetAsset (task._asset);
+			if (!IsPipelined (task._asset) || !asset->Has (AssetComponentType::Geometry)){
+				continue;
+			}
+			std::shared_ptr <Assets::Geometry> geometry = asset->Get <Assets::Geometry> (AssetComponentType::Geometry);
+			if (std::find (_geometries.begin (), _geometries.end (), geometry) == _geometries.end ()){
+				geometry->SetPipelined (true);
+				_geometries.push_back (geometry);
+			}
+		}
+	}
+
+	void TaskGraph::Link (size_t from, size_t to)
+	{
+		if (from == to){
+			return;
+		}
+		vector <size_t>& predecessors = _tasks [to]._predecessors;
+		if (std::find (predecessors.begin (), predecessors.end (), from) == predecessors.end ()){
+			predecessors.push_back (from);
+		}
+	}
+
+	void TaskGraph::Reduce ()
+	{
+		// tasks reachable backwards from each task, predecessors come first in program order
+		size_t count = _tasks.size ();
+		vector <vector <bool> > reaches (count, vector <bool> (count, false));
+		for (size_t i = 0; i < count; ++i){
+			for (size_t p : _tasks [i]._predecessors){
+				reaches [i][p] = true;
+				for (size_t j = 0; j < p; ++j){
+					if (reaches [p][j]){
+						reaches [i][j] = true;
+					}
+				}
+			}
+		}
+
+		// an edge is redundant if another predecessor already depends on its source
+		for (size_t i = 0; i < count; ++i){
+			vector <size_t>& predecessors = _tasks [i]._predecessors;
+			vector <size_t> kept;
+			for (size_t p : predecessors){
+				bool implied = false;
+				for (size_t q : predecessors){
+					if (q != p && reaches [q][p]){
+						implied = true;
+						break;
+					}
+				}
+				if (!implied){
+					kept.push_back (p);
+				}
+			}
+			std::sort (kept.begin (), kept.end ());
+			predecessors.swap (kept);
+
+			for (size_t p : predecessors){
+				_tasks [p]._successors.push_back (i);
+			}
+			_edges += predecessors.size ();
+			if (predecessors.empty ()){
+				_roots.push_back (i);
+			}
+		}
+	}
+}
@@ -0,0 +1,185 @@
+/**
+ * @file TaskGraph.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * The per-frame task graph shared by the task managers, read from a
+ * config like TbbConfig.xml. Top level Tasks are stages that run one
+ * after another in Index order. The children of a Parallel task or
+ * SubTask may run concurrently, those of a Serial one run in order. The
+ * leaves update one component of one asset. The Component attribute of a
+ * task is inherited by its children, and the Plugin attribute is only
+ * informative. Leaves whose asset or component was not loaded are
+ * dropped with a warning, so the graph only holds runnable work.
+ *
+ * The updates are flattened into a DAG. With Dependencies="Config" on the
+ * root element, its edges follow the task structure above. With
+ * Dependencies="Inferred", the structure only gives the program order,
+ * and an update depends on an earlier one only if their data accesses
+ * (Component::Access ()) conflict: read after write, write after read or
+ * write after write of the same data of the same asset. The data read
+ * from other assets comes from the assets listed in the Touches attribute
+ * of a leaf, or from all assets in the graph without one. Redundant edges
+ * are removed in both modes. Every update is timed, and the critical path
+ * is reported at initialization (in updates) and once measured.
+ *
+ * With Frames="Pipelined", the consumers of a finished frame read the
+ * previous vertex buffers (AssetData::PresentedGeometry) while physics
+ * writes the next frame into the current ones, so with inferred
+ * dependencies rendering frame N overlaps physics of frame N+1. The end
+ * of the frame is the barrier: once every update is done, EndFrame ()
+ * flips the buffers of all geometries in the graph, before any update of
+ * the next frame starts, so Geometry updates of those assets are dropped
+ * with a warning. The geometries that the fixed rate lanes use
+ * (see Tasks/RateScheduler.h) are left out: their assets keep sequential
+ * frames, as the lanes would see their buffers flip under them.
+ *
+ * The graph is built once and kept. The parsed config is kept with it, so
+ * when the assets change (AssetManager::Structure ()), Rebuild () binds
+ * and links the updates again without reading the config, and the
+ * updates that remain keep their measured costs. The task managers check
+ * IsStale () between frames.
+ */
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tinyxml2.h"
+
+#include "Types.h"
+#include "Asset/Component.h"
+#include "Asset/Geometry.h"
+
+namespace Sim {
+
+	// frames timed before the measured critical path is reported
+	const unsigned int SIM_TASK_COST_FRAMES = 60;
+	// frames after building the graph before frames must not allocate (debug builds)
+	const unsigned int SIM_TASK_WARMUP_FRAMES = 8;
+
+	enum class TaskOrder {
+		Serial,
+		Parallel
+	};
+
+	// task as read from the config
+	struct TaskNode {
+		TaskOrder _order = TaskOrder::Serial;
+		std::vector <TaskNode> _children;
+
+		// leaves only
+		AssetId _asset = AssetId::Unknown;
+		AssetComponentType _component = AssetComponentType::Unknown;
+		std::shared_ptr <Assets::Component> _target;
+		// assets whose data the update reads, all of them if not given
+		bool _touchesAll = true;
+		std::vector <AssetId> _touches;
+
+		bool IsLeaf () const {return _asset != AssetId::Unknown;}
+	};
+
+	// one component update in the flattened graph
+	struct GraphTask {
+		AssetId _asset = AssetId::Unknown;
+		AssetComponentType _component = AssetComponentType::Unknown;
+		std::shared_ptr <Assets::Component> _target;
+		// "Asset/Component", for reports
+		std::string _name;
+
+		// data the update touches, of the assets in _touches (or all assets) for the other assets
+		DataAccess _access;
+		bool _touchesAll = true;
+		std::vector <AssetId> _touches;
+
+		std::vector <size_t> _predecessors;
+		std::vector <size_t> _successors;
+
+		// smoothed update time in microseconds, zero until measured
+		double _cost = 0.0;
+	};
+
+	class TaskGraph {
+
+		private:
+			// in program order, which is a topological order
+			std::vector <GraphTask> _tasks;
+			std::vector <size_t> _roots;
+			size_t _edges = 0;
+			bool _inferred = false;
+			unsigned int _frame = 0;
+
+			bool _pipelined = false;
+			// geometries of the assets in the graph, flipped at the end of pipelined frames
+			std::vector <std::shared_ptr <Assets::Geometry> > _geometries;
+			// assets whose frames stay sequential (their geometry is used outside of the graph)
+			std::vector <AssetId> _sequential;
+
+			// stages as read from the config (by Index, not bound to the assets), for rebuilds
+			std::vector <std::pair <unsigned int, TaskNode> > _stages;
+			std::string _source;
+			// asset structure the graph was built for
+			unsigned int _structure = 0;
+
+		public:
+			TaskGraph () = default;
+			~TaskGraph () = default;
+
+			TaskGraph (const TaskGraph&) = delete;
+			TaskGraph& operator = (const TaskGraph&) = delete;
+
+			// parses the config, binds the leaves to the components of the loaded assets and links them
+			bool Initialize (const char* config, const char* rootName);
+			// same, from the Task elements under 'root' ('source' names it in the log)
+			bool Initialize (tinyxml2::XMLElement& root, const char* source);
+			void Cleanup ();
+			// true once the assets changed since the graph was built
+			bool IsStale () const;
+			// builds the graph again for the current assets. Only between frames
+			bool Rebuild ();
+			// keeps the frames of 'assets' sequential when pipelined (relinks the graph if that changes it)
+			void KeepSequential (const std::vector <AssetId>& assets);
+
+			// number of component updates per frame
+			size_t Size () const {return _tasks.size ();}
+			const GraphTask& Task (size_t index) const {return _tasks [index];}
+			// updates without predecessors
+			const std::vector <size_t>& Roots () const {return _roots;}
+			bool IsPipelined () const {return _pipelined;}
+
+			// updates and times task 'index'. Each task must run once per frame, after its predecessors
+			void Run (size_t index);
+			// called by the task manager once all tasks of the frame ran, and before the next frame starts
+			void EndFrame ();
+			// runs all the updates on the calling thread, in program order
+			void RunSerial ();
+
+			// length of the longest chain, in microseconds once measured and in updates before
+			double CriticalPath (std::vector <size_t>* path = nullptr) const;
+			void ReportCriticalPath () const;
+
+		private:
+			// binds and links the stages, restoring the given costs by task name
+			bool Build (const std::map <std::string, double>& costs);
+			// clears the bound graph and builds it again, keeping the costs
+			bool Relink ();
+			bool Parse (tinyxml2::XMLElement&, AssetComponentType, TaskNode&);
+			bool Bind (TaskNode&);
+
+			void Flatten (const TaskNode&);
+			// edges of the config structure; 'after' receives the tasks that finish 'node'
+			void LinkStructure (const TaskNode& node, size_t& next, const std::vector <size_t>& before, std::vector <size_t>& after);
+			void LinkAccesses ();
+			// true if 'asset' overlaps physics and rendering
+			bool IsPipelined (AssetId asset) const;
+			void BindGeometries ();
+			void Link (size_t from, size_t to);
+			// drops the edges implied by longer paths
+			void Reduce ();
+	};
+}
@@ -0,0 +1,40 @@
+/**
+ * @file TaskManager.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See TaskManager.h.
+ */
+
+#include <chrono>
+
+#include "Tasks/TaskManager.h"
+#include "Tasks/WorkPartition.h"
+
+using std::chrono::steady_clock;
+
+namespace Sim {
+
+	void TaskManager::PartitionedFor (WorkPartition& partition, const ItemTask& task)
+	{
+		if (partition.Size () == 0){
+			return;
+		}
+		partition.Balance (Concurrency ());
+
+		// one range per bin: a bin whose worker is busy elsewhere can still be taken by an idle one
+		ParallelFor (0, partition.Bins (), [&partition, &task] (size_t begin, size_t end) {
+			for (size_t b = begin; b < end; ++b){
+				for (size_t i = partition.BinBegin (b); i < partition.BinEnd (b); ++i){
+					size_t item = partition.Item (i);
+					steady_clock::time_point start = steady_clock::now ();
+					task (item);
+					partition.Record (item, std::chrono::duration <double, std::micro> (steady_clock::now () - start).count ());
+				}
+			}
+		}, 1);
+		partition.EndPass ();
+	}
+}
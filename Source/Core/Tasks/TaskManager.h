@@ -9,12 +9,28 @@
  */
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <memory>
 
+#include "Tasks/IOExecutor.h"
+
 namespace Sim {
 
+	// body of a parallel loop, called on sub-ranges [begin, end)
+	typedef std::function <void (size_t begin, size_t end)> RangeTask;
+	// body of a partitioned loop, called once per item
+	typedef std::function <void (size_t item)> ItemTask;
+
+	struct RateStats;
+	class WorkPartition;
+
 	class TaskManager {
 
+	protected:
+		// blocking work, started and stopped by the implementations
+		IOExecutor _io;
+
 	public:
 		TaskManager () = default;
 		virtual ~TaskManager () = default;
@@ -25,5 +41,26 @@ namespace Sim {
 		virtual bool Initialize (const char* config) {return true;}
 		virtual void Update () {}
 		virtual void Cleanup () {}
+
+		// runs 'task' over [begin, end) split into ranges of at least 'grain' (zero picks one)
+		virtual void ParallelFor (size_t begin, size_t end, const RangeTask& task, size_t grain = 0)
+		{
+			if (begin < end){
+				task (begin, end);
+			}
+		}
+
+		// runs 'task' on every item of 'partition', balanced on the item costs, and times the items
+		void PartitionedFor (WorkPartition& partition, const ItemTask& task);
+		// number of threads running the tasks
+		virtual unsigned int Concurrency () const {return 1;}
+
+		// runs 'work' on the compute pool some time later, outside of the frame tasks
+		virtual void Enqueue (std::function <void ()> work) {work ();}
+		// executor of the blocking jobs (file reads etc.), see Tasks/IOExecutor.h
+		IOExecutor& IO () {return _io;}
+
+		// statistics of a fixed rate lane (see Tasks/RateScheduler.h), false if there is no such lane
+		virtual bool LaneStats (const char* name, RateStats& stats) const {return false;}
 	};
 }
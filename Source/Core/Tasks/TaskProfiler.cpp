@@ -0,0 +1,318 @@
+/**
+ * @file TaskProfiler.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See TaskProfiler.h.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "Log.h"
+#include "ConfigParser.h"
+#include "Tasks/TaskGraph.h"
+#include "Tasks/TaskProfiler.h"
+
+using std::string;
+using std::vector;
+using tinyxml2::XMLElement;
+
+namespace Sim {
+
+	namespace {
+		// buffer of the calling thread in the current session
+		struct LocalBuffer {
+			unsigned int _session = 0;
+			void* _buffer = nullptr;
+			string _name;
+		};
+		thread_local LocalBuffer local;
+
+		const char* TypeName (TraceType type)
+		{
+			switch (type){
+				case TraceType::Frame: return "frame";
+				case TraceType::Idle: return "idle";
+				case TraceType::Steal: return "steal";
+				default: return "task";
+			}
+		}
+
+		// JSON string contents (names are plain, but thread names come from configs)
+		string Escape (const string& text)
+		{
+			string escaped;
+			for (char c : text){
+				if (c == '"' || c == '\\'){
+					escaped += '\\';
+				}
+				escaped += c;
+			}
+			return escaped;
+		}
+	}
+
+	TaskProfiler& TaskProfiler::Instance ()
+	{
+		// never destroyed: worker threads may still hold on to their buffers
+		static TaskProfiler* profiler = new TaskProfiler;
+		return *profiler;
+	}
+
+	bool TaskProfiler::Initialize (const char* config, const char* rootName)
+	{
+		ConfigParser parser;
+		if (!parser.Initialize (config, rootName)){
+			LOG_ERROR ("Could not initialize parser for " << config);
+			return false;
+		}
+
+		// <Profiler File="TaskTrace.json" [Summary="TaskSummary.txt"] [Frames="300"]/>
+		XMLElement* element = parser.GetRoot ()->FirstChildElement ("Profiler");
+		if (element == nullptr){
+			return true;
+		}
+#		ifndef SIM_TASK_PROFILER_ENABLED
+		LOG_WARNING ("Task profiler requested in " << config << " but not built in (SIM_TASK_PROFILER_ENABLED)");
+		return true;
+#		endif
+
+		const char* file = element->Attribute ("File");
+		if (file == nullptr){
+			LOG_ERROR ("Profiler without \'File\' in " << config);
+			return false;
+		}
+		unsigned int frames = 0;
+		element->QueryUnsignedAttribute ("Frames", &frames);
+		Start (file, element->Attribute ("Summary"), frames);
+		return true;
+	}
+
+	void TaskProfiler::Start (const char* traceFile, const char* summaryFile, unsigned int frames)
+	{
+		if (IsEnabled ()){
+			LOG_WARNING ("Task profiler already running");
+			return;
+		}
+
+		{
+			std::lock_guard <std::mutex> loki (_mutex);
+			// threads of an earlier session may still write to their old buffers: they are only dropped from the list
+			for (auto& buffer : _threads){
+				buffer.release ();
+			}
+			_threads.clear ();
+			_traceFile = traceFile;
+			_summaryFile = summaryFile ? summaryFile : "";
+			_frames = frames;
+			_frame = 0;
+			_epoch = std::chrono::steady_clock::now ();
+			++_session;
+		}
+		_enabled.store (true, std::memory_order_release);
+		LOG ("Task profiler started, writing " << traceFile << (frames > 0 ? " after " + std::to_string (frames) + " frames" : string (" on cleanup")));
+	}
+
+	void TaskProfiler::Stop (const TaskGraph* frame)
+	{
+		if (!_enabled.exchange (false)){
+			return;
+		}
+
+		if (Export (_traceFile.c_str ())){
+			LOG ("Task trace written to " << _traceFile);
+		}
+
+		string summary = Summary (frame);
+		std::istringstream lines (summary);
+		string line;
+		while (std::getline (lines, line)){
+			LOG (line);
+		}
+		if (!_summaryFile.empty ()){
+			std::ofstream file (_summaryFile);
+			if (!file){
+				LOG_ERROR ("Could not write the task summary to " << _summaryFile);
+			}
+			file << summary;
+		}
+	}
+
+	TaskProfiler::ThreadBuffer& TaskProfiler::Local ()
+	{
+		unsigned int session = _session.load (std::memory_order_acquire);
+		if (local._session != session || local._buffer == nullptr){
+			std::lock_guard <std::mutex> loki (_mutex);
+			_threads.emplace_back (new ThreadBuffer);
+			ThreadBuffer& buffer = *_threads.back ();
+			buffer._events.reset (new TraceEvent [SIM_PROFILER_EVENTS_PER_THREAD]);
+			buffer._name = local._name.empty () ? "Thread " + std::to_string (_threads.size () - 1) : local._name;
+			local._buffer = &buffer;
+			local._session = session;
+		}
+		return *static_cast <ThreadBuffer*> (local._buffer);
+	}
+
+	void TaskProfiler::NameThread (const string& name)
+	{
+		local._name = name;
+		if (IsEnabled ()){
+			ThreadBuffer& buffer = Local ();
+			std::lock_guard <std::mutex> loki (_mutex);
+			buffer._name = name;
+		}
+	}
+
+	void TaskProfiler::Record (TraceType type, const char* name, long long start, long long end, unsigned int victim)
+	{
+		ThreadBuffer& buffer = Local ();
+		size_t count = buffer._count.load (std::memory_order_relaxed);
+		if (count >= SIM_PROFILER_EVENTS_PER_THREAD){
+			buffer._dropped.fetch_add (1, std::memory_order_relaxed);
+			return;
+		}
+		TraceEvent& event = buffer._events [count];
+		event._type = type;
+		event._victim = victim;
+		event._name = name;
+		event._start = start;
+		event._end = end;
+		// publishes the event to Export ()
+		buffer._count.store (count + 1, std::memory_order_release);
+	}
+
+	void TaskProfiler::EndFrame (long long start, const TaskGraph& frame)
+	{
+		Record (TraceType::Frame, nullptr, start, Now ());
+		if (_frames > 0 && _frame.fetch_add (1, std::memory_order_relaxed) + 1 == _frames){
+			Stop (&frame);
+		}
+	}
+
+	bool TaskProfiler::Export (const char* file) const
+	{
+		std::ofstream out (file);
+		if (!out){
+			LOG_ERROR ("Could not write the task trace to " << file);
+			return false;
+		}
+
+		// complete ("X") events for spans, instant ("i") ones for steals, timestamps in microseconds
+		out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+		bool first = true;
+		std::lock_guard <std::mutex> loki (_mutex);
+		for (size_t t = 0; t < _threads.size (); ++t){
+			const ThreadBuffer& buffer = *_threads [t];
+			out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t << ",\"args\":{\"name\":\"" << Escape (buffer._name) << "\"}}";
+			first = false;
+
+			size_t count = buffer._count.load (std::memory_order_acquire);
+			for (size_t i = 0; i < count; ++i){
+				const TraceEvent& e = buffer._events [i];
+				out << ",\n{\"name\":\"" << (e._name ? e._name : TypeName (e._type)) << "\",\"cat\":\"" << TypeName (e._type) << "\",\"pid\":1,\"tid\":" << t
+					<< ",\"ts\":" << e._start/1000.0;
+				if (e._type == TraceType::Steal){
+					out << ",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"victim\":" << e._victim << "}}";
+				}
+				else {
+					out << ",\"ph\":\"X\",\"dur\":" << (e._end - e._start)/1000.0 << "}";
+				}
+			}
+		}
+		out << "\n]}\n";
+		return true;
+	}
+
+	string TaskProfiler::Summary (const TaskGraph* frame) const
+	{
+		std::lock_guard <std::mutex> loki (_mutex);
+
+		// profiled window
+		long long begin = 0, end = 0;
+		bool any = false;
+		std::map <string, vector <double> > tasks;
+		vector <double> frames;
+		for (auto& buffer : _threads){
+			size_t count = buffer->_count.load (std::memory_order_acquire);
+			for (size_t i = 0; i < count; ++i){
+				const TraceEvent& e = buffer->_events [i];
+				begin = any ? std::min (begin, e._start) : e._start;
+				end = any ? std::max (end, e._end) : e._end;
+				any = true;
+				if (e._type == TraceType::Task){
+					tasks [e._name].push_back ((e._end - e._start)/1000.0);
+				}
+				else if (e._type == TraceType::Frame){
+					frames.push_back ((e._end - e._start)/1000.0);
+				}
+			}
+		}
+		std::ostringstream out;
+		if (!any){
+			out << "Task profile: no events recorded\n";
+			return out.str ();
+		}
+		double window = (end - begin)/1000.0;
+		out << "Task profile of " << window/1000.0 << " ms and " << frames.size () << " frames\n";
+
+		// per task
+		double total = 0.0;
+		for (auto& t : tasks){
+			vector <double>& times = t.second;
+			std::sort (times.begin (), times.end ());
+			double sum = 0.0;
+			for (double time : times){
+				sum += time;
+			}
+			total += sum;
+			size_t p99 = std::min (times.size () - 1, static_cast <size_t> (0.99*times.size ()));
+			out << "  " << t.first << ": " << times.size () << " runs, mean " << sum/times.size () << " us, p99 " << times [p99] << " us\n";
+		}
+
+		// per thread
+		for (auto& buffer : _threads){
+			double busy = 0.0, idle = 0.0;
+			size_t steals = 0;
+			size_t count = buffer->_count.load (std::memory_order_acquire);
+			for (size_t i = 0; i < count; ++i){
+				const TraceEvent& e = buffer->_events [i];
+				if (e._type == TraceType::Task){
+					busy += (e._end - e._start)/1000.0;
+				}
+				else if (e._type == TraceType::Idle){
+					idle += (e._end - e._start)/1000.0;
+				}
+				else if (e._type == TraceType::Steal){
+					++steals;
+				}
+			}
+			out << "  " << buffer->_name << ": " << 100.0*busy/window << "% busy, " << 100.0*idle/window << "% idle, " << steals << " steals";
+			size_t dropped = buffer->_dropped.load (std::memory_order_relaxed);
+			if (dropped > 0){
+				out << ", " << dropped << " events dropped";
+			}
+			out << "\n";
+		}
+
+		// per frame
+		if (!frames.empty ()){
+			double sum = 0.0;
+			for (double time : frames){
+				sum += time;
+			}
+			double mean = sum/frames.size ();
+			out << "  Frame: mean " << mean << " us, max " << *std::max_element (frames.begin (), frames.end ()) << " us, "
+				<< total/frames.size () << " us of updates per frame (parallelism " << total/sum << ")";
+			if (frame != nullptr){
+				out << ", critical path " << frame->CriticalPath () << " us (" << 100.0*frame->CriticalPath ()/mean << "% of the frame)";
+			}
+			out << "\n";
+		}
+		return out.str ();
+	}
+}
@@ -0,0 +1,118 @@
+/**
+ * @file TaskProfiler.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Instrumentation of the task managers. While enabled, every thread
+ * appends the start and end of its component updates and frames, the
+ * time it spent idle and the tasks it stole to a buffer of its own (no
+ * locks, no allocation; a full buffer drops events). Profiling starts
+ * with the task manager when its config has a Profiler element:
+ *
+ *   <Profiler File="TaskTrace.json" Summary="TaskSummary.txt" Frames="300"/>
+ *
+ * and stops after the given number of frames (or on cleanup). The events
+ * are then written as Chrome trace_event JSON (chrome://tracing, Perfetto)
+ * and summed up per task (mean, p99), per thread (utilization, idle time,
+ * steals) and per frame (frame time against the critical path).
+ * Without SIM_TASK_PROFILER_ENABLED, IsEnabled () is always false and
+ * the hooks compile away.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Config.h"
+
+namespace Sim {
+
+	class TaskGraph;
+
+	// events recorded per thread before dropping
+	const size_t SIM_PROFILER_EVENTS_PER_THREAD = 1 << 16;
+
+	enum class TraceType : unsigned char {
+		Task,
+		Frame,
+		Idle,
+		Steal
+	};
+
+	struct TraceEvent {
+		TraceType _type = TraceType::Task;
+		// worker robbed, for steals
+		unsigned int _victim = 0;
+		// task name (owned by its task graph) for tasks
+		const char* _name = nullptr;
+		// nanoseconds since profiling started
+		long long _start = 0;
+		long long _end = 0;
+	};
+
+	class TaskProfiler {
+
+		private:
+			struct ThreadBuffer {
+				std::string _name;
+				std::unique_ptr <TraceEvent []> _events;
+				std::atomic <size_t> _count {0};
+				std::atomic <size_t> _dropped {0};
+			};
+
+			std::atomic <bool> _enabled {false};
+			// changes with every session, so threads register their buffer again
+			std::atomic <unsigned int> _session {0};
+			std::chrono::steady_clock::time_point _epoch;
+
+			// registered buffers (guarded by _mutex), never freed while the profiler lives
+			mutable std::mutex _mutex;
+			std::vector <std::unique_ptr <ThreadBuffer> > _threads;
+
+			std::string _traceFile;
+			std::string _summaryFile;
+			unsigned int _frames = 0;
+			std::atomic <unsigned int> _frame {0};
+
+			TaskProfiler () = default;
+
+		public:
+			static TaskProfiler& Instance ();
+			~TaskProfiler () = default;
+
+			TaskProfiler (const TaskProfiler&) = delete;
+			TaskProfiler& operator = (const TaskProfiler&) = delete;
+
+			// starts a session if the config has a Profiler element
+			bool Initialize (const char* config, const char* rootName);
+			void Start (const char* traceFile, const char* summaryFile, unsigned int frames);
+			// ends the session and writes its trace and summary, 'frame' giving the critical path
+			void Stop (const TaskGraph* frame);
+
+#			ifdef SIM_TASK_PROFILER_ENABLED
+			inline bool IsEnabled () const {return _enabled.load (std::memory_order_acquire);}
+#			else
+			inline bool IsEnabled () const {return false;}
+#			endif
+
+			// nanoseconds since the session started
+			long long Now () const {return std::chrono::duration_cast <std::chrono::nanoseconds> (std::chrono::steady_clock::now () - _epoch).count ();}
+
+			void Record (TraceType type, const char* name, long long start, long long end, unsigned int victim = 0);
+			// names the calling thread in the trace
+			void NameThread (const std::string& name);
+			// records a frame of the task manager, and ends the session after the configured frames
+			void EndFrame (long long start, const TaskGraph& frame);
+
+		private:
+			ThreadBuffer& Local ();
+			bool Export (const char* file) const;
+			std::string Summary (const TaskGraph* frame) const;
+	};
+}
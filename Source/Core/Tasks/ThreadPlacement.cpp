@@ -0,0 +1,316 @@
+/**
+ * @file ThreadPlacement.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See ThreadPlacement.h.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "Log.h"
+#include "ConfigParser.h"
+#include "Tasks/ThreadPlacement.h"
+
+using std::string;
+using std::vector;
+using tinyxml2::XMLElement;
+using tinyxml2::XML_SUCCESS;
+
+namespace Sim {
+
+	namespace {
+		const char* SIM_SYSFS_CPU = "/sys/devices/system/cpu/";
+
+		bool ReadLine (const string& path, string& line)
+		{
+			std::ifstream file (path);
+			return file && std::getline (file, line);
+		}
+
+		unsigned int ReadNumber (const string& path, unsigned int fallback)
+		{
+			string line;
+			return ReadLine (path, line) && !line.empty () ? static_cast <unsigned int> (strtoul (line.c_str (), nullptr, 10)) : fallback;
+		}
+
+		bool Contains (const vector <unsigned int>& cpus, unsigned int id)
+		{
+			return std::find (cpus.begin (), cpus.end (), id) != cpus.end ();
+		}
+
+		// reads the processor list in attribute 'name', checking that they are online
+		bool ReadCpus (XMLElement& element, const char* name, const char* config, vector <unsigned int>& cpus)
+		{
+			const char* text = element.Attribute (name);
+			if (text == nullptr){
+				return true;
+			}
+			if (!ParseCpuList (text, cpus)){
+				LOG_ERROR ("Malformed processor list \'" << text << "\' in " << element.Name () << " of " << config);
+				return false;
+			}
+			Cpu cpu;
+			for (unsigned int id : cpus){
+				if (!Topology::Instance ().Find (id, cpu)){
+					LOG_ERROR ("Processor " << id << " in " << element.Name () << " of " << config << " is not online");
+					return false;
+				}
+			}
+			return true;
+		}
+	}
+
+	Topology::Topology ()
+	{
+		vector <unsigned int> online;
+		string line;
+		if (!ReadLine (string (SIM_SYSFS_CPU) + "online", line) || !ParseCpuList (line.c_str (), online)){
+			LOG_WARNING ("Could not read the processor topology, assuming one socket");
+			unsigned int count = std::max (1u, std::thread::hardware_concurrency ());
+			for (unsigned int i = 0; i < count; ++i){
+				online.push_back (i);
+			}
+		}
+
+		std::map <std::pair <unsigned int, unsigned int>, unsigned int> siblings;
+		for (unsigned int id : online){
+			Cpu cpu;
+			cpu._id = id;
+			string topology = string (SIM_SYSFS_CPU) + "cpu" + std::to_string (id) + "/topology/";
+			cpu._package = ReadNumber (topology + "physical_package_id", 0);
+			cpu._core = ReadNumber (topology + "core_id", id);
+			// online is sorted, so the lowest numbered thread of a core comes first
+			cpu._sibling = siblings [std::make_pair (cpu._package, cpu._core)]++;
+			_packages = std::max (_packages, cpu._package + 1);
+			_cpus.push_back (cpu);
+		}
+
+		// fill a socket with one thread per core, then its second threads, then the next socket
+		std::stable_sort (_cpus.begin (), _cpus.end (), [] (const Cpu& a, const Cpu& b) {
+			if (a._package != b._package){
+				return a._package < b._package;
+			}
+			return a._sibling != b._sibling ? a._sibling < b._sibling : a._core < b._core;
+		});
+	}
+
+	const Topology& Topology::Instance ()
+	{
+		static Topology* topology = new Topology;
+		return *topology;
+	}
+
+	bool Topology::Find (unsigned int id, Cpu& cpu) const
+	{
+		for (auto& c : _cpus){
+			if (c._id == id){
+				cpu = c;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool ThreadPlacement::Initialize (const char* config, const char* rootName)
+	{
+		ConfigParser parser;
+		if (!parser.Initialize (config, rootName)){
+			LOG_ERROR ("Could not initialize parser for " << config);
+			return false;
+		}
+		return Initialize (*parser.GetRoot (), config);
+	}
+
+	bool ThreadPlacement::Initialize (XMLElement& root, const char* config)
+	{
+		_pin = PinMode::Off;
+		_main.clear ();
+		_workers.clear ();
+
+		// processors reserved by the lanes
+		vector <unsigned int> reserved;
+		XMLElement* lane = root.FirstChildElement ("Lane");
+		while (lane != nullptr){
+			vector <unsigned int> cpus;
+			if (!ReadCpus (*lane, "Cpus", config, cpus)){
+				return false;
+			}
+			reserved.insert (reserved.end (), cpus.begin (), cpus.end ());
+			lane = lane->NextSiblingElement ("Lane");
+		}
+
+		// <Threads Main="0" [Workers="2-15"] [Socket="0"] [Pin="Core|Set"]/>
+		XMLElement* element = root.FirstChildElement ("Threads");
+		const Topology& topology = Topology::Instance ();
+		if (element == nullptr){
+			if (reserved.empty ()){
+				return true;
+			}
+			// the lane processors are still kept free: the other threads share the rest
+			for (auto& cpu : topology.Cpus ()){
+				if (!Contains (reserved, cpu._id)){
+					_workers.push_back (cpu._id);
+				}
+			}
+			if (_workers.empty ()){
+				LOG_ERROR ("No processors left besides those of the lanes in " << config);
+				return false;
+			}
+			_main = _workers;
+			_pin = PinMode::Set;
+			LOG ("Lanes reserve processors " << FormatCpuList (reserved) << ", the other threads share " << FormatCpuList (_workers));
+			return true;
+		}
+
+		const char* pin = element->Attribute ("Pin");
+		if (pin != nullptr && strcmp (pin, "Core") && strcmp (pin, "Set")){
+			LOG_ERROR ("Pin of Threads must be Core or Set in " << config);
+			return false;
+		}
+		PinMode mode = pin != nullptr && !strcmp (pin, "Set") ? PinMode::Set : PinMode::Core;
+
+		if (!ReadCpus (*element, "Main", config, _main)){
+			return false;
+		}
+		reserved.insert (reserved.end (), _main.begin (), _main.end ());
+
+		unsigned int socket = 0;
+		bool oneSocket = element->QueryUnsignedAttribute ("Socket", &socket) == XML_SUCCESS;
+		if (oneSocket && socket >= topology.Packages ()){
+			LOG_ERROR ("Socket " << socket << " of Threads in " << config << " does not exist (" << topology.Packages () << " sockets)");
+			return false;
+		}
+
+		vector <unsigned int> workers;
+		bool listed = element->Attribute ("Workers") != nullptr;
+		if (!ReadCpus (*element, "Workers", config, workers)){
+			return false;
+		}
+		for (auto& cpu : topology.Cpus ()){
+			if (listed ? !Contains (workers, cpu._id) : Contains (reserved, cpu._id) || (oneSocket && cpu._package != socket)){
+				continue;
+			}
+			if (listed && Contains (reserved, cpu._id)){
+				LOG_WARNING ("Processor " << cpu._id << " of the workers is also reserved in " << config);
+			}
+			_workers.push_back (cpu._id);
+		}
+		if (_workers.empty ()){
+			LOG_ERROR ("No processors left for the workers in " << config);
+			return false;
+		}
+
+		_pin = mode;
+		LOG ("Threads placed on " << topology.Cpus ().size () << " processors in " << topology.Packages () << " sockets: main on "
+			<< (_main.empty () ? string ("any") : FormatCpuList (_main)) << ", workers on " << FormatCpuList (_workers)
+			<< (_pin == PinMode::Core ? " (one each)" : " (shared)"));
+		return true;
+	}
+
+	vector <unsigned int> ThreadPlacement::WorkerCpus (unsigned int index) const
+	{
+		if (_pin == PinMode::Core && !_workers.empty ()){
+			return vector <unsigned int> (1, _workers [index % _workers.size ()]);
+		}
+		return _pin == PinMode::Set ? _workers : vector <unsigned int> ();
+	}
+
+	bool ParseCpuList (const char* text, vector <unsigned int>& cpus)
+	{
+		cpus.clear ();
+		std::istringstream list (text);
+		string range;
+		while (std::getline (list, range, ',')){
+			char* end = nullptr;
+			const char* begin = range.c_str ();
+			unsigned long first = strtoul (begin, &end, 10);
+			if (end == begin){
+				return false;
+			}
+			unsigned long last = first;
+			if (*end == '-'){
+				begin = end + 1;
+				last = strtoul (begin, &end, 10);
+				if (end == begin || last < first){
+					return false;
+				}
+			}
+			while (*end == ' ' || *end == '\n'){
+				++end;
+			}
+			if (*end != '\0'){
+				return false;
+			}
+			for (unsigned long id = first; id <= last; ++id){
+				if (!Contains (cpus, static_cast <unsigned int> (id))){
+					cpus.push_back (static_cast <unsigned int> (id));
+				}
+			}
+		}
+		return !cpus.empty ();
+	}
+
+	string FormatCpuList (const vector <unsigned int>& cpus)
+	{
+		vector <unsigned int> sorted (cpus);
+		std::sort (sorted.begin (), sorted.end ());
+		std::ostringstream out;
+		for (size_t i = 0; i < sorted.size (); ){
+			size_t j = i;
+			while (j + 1 < sorted.size () && sorted [j + 1] == sorted [j] + 1){
+				++j;
+			}
+			out << (i > 0 ? "," : "") << sorted [i];
+			if (j > i){
+				out << "-" << sorted [j];
+			}
+			i = j + 1;
+		}
+		return out.str ();
+	}
+
+	bool PinThread (const vector <unsigned int>& cpus)
+	{
+		cpu_set_t set;
+		CPU_ZERO (&set);
+		if (cpus.empty ()){
+			for (auto& cpu : Topology::Instance ().Cpus ()){
+				CPU_SET (cpu._id, &set);
+			}
+		}
+		for (unsigned int id : cpus){
+			CPU_SET (id, &set);
+		}
+		if (sched_setaffinity (0, sizeof (set), &set) != 0){
+			LOG_WARNING ("Could not pin thread to processors " << FormatCpuList (cpus) << ": " << strerror (errno));
+			return false;
+		}
+		return true;
+	}
+
+	bool SetRealtimePriority (int priority)
+	{
+		sched_param param;
+		param.sched_priority = std::max (sched_get_priority_min (SCHED_FIFO), std::min (priority, sched_get_priority_max (SCHED_FIFO)));
+		int error = pthread_setschedparam (pthread_self (), SCHED_FIFO, &param);
+		if (error != 0){
+			LOG_WARNING ("Could not run thread with SCHED_FIFO priority " << param.sched_priority << ": " << strerror (error));
+			return false;
+		}
+		return true;
+	}
+}
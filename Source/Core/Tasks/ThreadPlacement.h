@@ -0,0 +1,96 @@
+/**
+ * @file ThreadPlacement.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Placement of the task manager threads on the processors of the machine.
+ * The topology (online processors, their package and core) is read from
+ * sysfs. A Threads element in the task config reserves processors for the
+ * driver thread (which also runs the X/GL work) and gives the workers the
+ * processors left:
+ *
+ *   <Threads Main="0" [Workers="2-15"] [Socket="0"] [Pin="Core|Set"]/>
+ *
+ * Workers defaults to every online processor not taken by Main or by the
+ * Cpus of a Lane (see Tasks/RateScheduler.h), optionally restricted to
+ * one socket. With Pin="Core" (the default), each worker is bound to a
+ * processor of its own, physical cores of the first socket first, so it
+ * never migrates away from the caches holding its working set. With
+ * Pin="Set", the workers share the whole set. Without a Threads element,
+ * the Cpus of the lanes are still kept free: the driver, worker and I/O
+ * threads share the processors left. Processor lists are comma
+ * separated numbers and ranges ("0,2-5"), as in sysfs and taskset.
+ * Pinning uses sched_setaffinity and a failure to pin is only logged.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "tinyxml2.h"
+
+namespace Sim {
+
+	// online processor, as seen by the kernel
+	struct Cpu {
+		unsigned int _id = 0;
+		unsigned int _package = 0;
+		unsigned int _core = 0;
+		// 0 for the first hardware thread of its core, 1 for the next etc.
+		unsigned int _sibling = 0;
+	};
+
+	class Topology {
+
+		private:
+			// by package, sibling and core
+			std::vector <Cpu> _cpus;
+			unsigned int _packages = 1;
+
+			Topology ();
+
+		public:
+			static const Topology& Instance ();
+
+			Topology (const Topology&) = delete;
+			Topology& operator = (const Topology&) = delete;
+
+			const std::vector <Cpu>& Cpus () const {return _cpus;}
+			unsigned int Packages () const {return _packages;}
+			// false if 'id' is not an online processor
+			bool Find (unsigned int id, Cpu& cpu) const;
+	};
+
+	enum class PinMode {
+		Off,
+		Core,
+		Set
+	};
+
+	struct ThreadPlacement {
+		PinMode _pin = PinMode::Off;
+		// processors of the driver thread
+		std::vector <unsigned int> _main;
+		// processors of the worker threads, in the order they are handed out
+		std::vector <unsigned int> _workers;
+
+		// reads the Threads element under 'root', if any. Lane processors are left out of the workers
+		bool Initialize (tinyxml2::XMLElement& root, const char* config);
+		bool Initialize (const char* config, const char* rootName);
+
+		bool IsPinned () const {return _pin != PinMode::Off;}
+		// processors of the 'index'th worker thread (not counting the driver thread)
+		std::vector <unsigned int> WorkerCpus (unsigned int index) const;
+	};
+
+	// parses "0,2-5" into its processors, false on malformed lists
+	bool ParseCpuList (const char* text, std::vector <unsigned int>& cpus);
+	std::string FormatCpuList (const std::vector <unsigned int>& cpus);
+
+	// binds the calling thread to 'cpus' (all online processors if empty)
+	bool PinThread (const std::vector <unsigned int>& cpus);
+	// moves the calling thread to SCHED_FIFO at 'priority' (needs CAP_SYS_NICE or an rtprio limit)
+	bool SetRealtimePriority (int priority);
+}
@@ -0,0 +1,448 @@
+/**
+ * @file ThreadManager.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See ThreadManager.h.
+ */
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "Log.h"
+#include "Driver/Driver.h"
+#include "Tasks/TaskProfiler.h"
+#include "Tasks/Threads/ThreadManager.h"
+
+namespace Sim {
+
+	namespace {
+		std::atomic <unsigned int> instances {0};
+
+		// worker index of the calling thread, valid while instance matches the manager
+		struct LocalWorker {
+			unsigned int _instance = 0;
+			int _index = -1;
+		};
+		thread_local LocalWorker local;
+	}
+
+	void TaskGroup::Wait ()
+	{
+		// time spent without anything to run is idle
+		TaskProfiler& profiler = TaskProfiler::Instance ();
+		long long idle = -1;
+		while (_pending.load (std::memory_order_acquire) > 0){
+			if (_manager.RunOne ()){
+				if (idle >= 0){
+					profiler.Record (TraceType::Idle, nullptr, idle, profiler.Now ());
+					idle = -1;
+				}
+			}
+			else {
+				if (idle < 0 && profiler.IsEnabled ()){
+					idle = profiler.Now ();
+				}
+				std::this_thread::yield ();
+			}
+		}
+		if (idle >= 0){
+			profiler.Record (TraceType::Idle, nullptr, idle, profiler.Now ());
+		}
+	}
+
+	ThreadManager::ThreadManager (unsigned int concurrency): _instance (++instances), _concurrency (concurrency), _frame (*this), _background (*this) {}
+
+	ThreadManager::~ThreadManager () {Cleanup ();}
+
+	bool ThreadManager::Initialize (const char* config)
+	{
+		if (_running){
+			LOG_WARNING ("Thread manager already initialized");
+			Cleanup ();
+		}
+
+		if (config != nullptr && !_tasks.Initialize (config, "TBBConfig")){
+			LOG_ERROR ("Could not read task graph from " << config);
+			return false;
+		}
+
+		if (config != nullptr && !_placement.Initialize (config, "TBBConfig")){
+			LOG_ERROR ("Could not read the thread placement of " << config);
+			return false;
+		}
+		unsigned int count = _concurrency > 0 ? _concurrency : std::thread::hardware_concurrency ();
+		if (_concurrency == 0 && _placement.IsPinned ()){
+			// the calling thread, and one worker per processor of the workers
+			count = static_cast <unsigned int> (_placement._workers.size ()) + 1;
+		}
+		if (count == 0){
+			count = 1;
+		}
+		for (unsigned int i = 0; i < count; ++i){
+			_workers.emplace_back (new Worker);
+			_workers.back ()->_seed = i + 1;
+		}
+
+		// the calling thread is worker 0, the others get their own thread
+		local._instance = _instance;
+		local._index = 0;
+		if (!_placement._main.empty ()){
+			PinThread (_placement._main);
+		}
+		delete new Task;
+		EventManager* events = Driver::Instance ().GetEventManager ();
+		if (events != nullptr){
+			events->AttachThread ();
+		}
+
+		_running = true;
+		for (unsigned int i = 1; i < count; ++i){
+			_workers [i]->_thread = std::thread (&ThreadManager::WorkerLoop, this, i);
+		}
+
+		TaskProfiler::Instance ().NameThread ("Worker 0");
+		if (config != nullptr && !TaskProfiler::Instance ().Initialize (config, "TBBConfig")){
+			LOG_ERROR ("Could not start the task profiler of " << config);
+			Cleanup ();
+			return false;
+		}
+		if (config != nullptr && !_rates.Initialize (config, "TBBConfig", _tasks)){
+			LOG_ERROR ("Could not start the task lanes of " << config);
+			Cleanup ();
+			return false;
+		}
+		// after the lanes, which may keep frames of the graph sequential
+		Compile ();
+		bool io = config != nullptr ? _io.Initialize (*this, config, "TBBConfig", _placement._main) : _io.Initialize (*this, SIM_IO_DEFAULT_THREADS, _placement._main);
+		if (!io){
+			LOG_ERROR ("Could not start the I/O threads of " << config);
+			Cleanup ();
+			return false;
+		}
+
+		LOG ("Thread manager initialized with " << count << " workers");
+		return true;
+	}
+
+	void ThreadManager::Cleanup ()
+	{
+		// the trace refers to the task names of the graphs
+		TaskProfiler::Instance ().Stop (&_tasks);
+		_rates.Cleanup ();
+		// the last I/O jobs may still enqueue their continuations
+		_io.Cleanup ();
+		if (!_running){
+			_tasks.Cleanup ();
+			_waiting.reset ();
+			_graphTasks.reset ();
+			return;
+		}
+
+		_background.Wait ();
+		_running = false;
+		{
+			std::lock_guard <std::mutex> loki (_sleepMutex);
+			_wake.notify_all ();
+		}
+		for (auto& w : _workers){
+			if (w->_thread.joinable ()){
+				w->_thread.join ();
+			}
+		}
+		_workers.clear ();
+
+		if (LocalIndex () == 0){
+			if (!_placement._main.empty ()){
+				PinThread (std::vector <unsigned int> ());
+			}
+			EventManager* events = Driver::Instance ().GetEventManager ();
+			if (events != nullptr){
+				events->DetachThread ();
+			}
+			local._instance = 0;
+			local._index = -1;
+		}
+		_tasks.Cleanup ();
+		_waiting.reset ();
+		_graphTasks.reset ();
+	}
+
+	void ThreadManager::Compile ()
+	{
+		_waiting.reset (new std::atomic <unsigned int> [_tasks.Size ()]);
+		_graphTasks.reset (new Task [_tasks.Size ()]);
+		for (size_t i = 0; i < _tasks.Size (); ++i){
+			_graphTasks [i].Bind ([this, i] () {RunTask (i);});
+			_graphTasks [i]._group = &_frame;
+			_graphTasks [i]._persistent = true;
+		}
+		_steadyFrames = 0;
+	}
+
+	void ThreadManager::Update ()
+	{
+		if (_tasks.IsStale ()){
+			// between frames: nothing runs the old tasks any more
+			_tasks.Rebuild ();
+			Compile ();
+		}
+		if (_rates.IsStale ()){
+			_rates.Rebuild ();
+		}
+		if (_tasks.Size () == 0){
+			return;
+		}
+		for (size_t i = 0; i < _tasks.Size (); ++i){
+			_waiting [i].store (static_cast <unsigned int> (_tasks.Task (i)._predecessors.size ()), std::memory_order_relaxed);
+		}
+
+		TaskProfiler& profiler = TaskProfiler::Instance ();
+		bool profiling = profiler.IsEnabled ();
+		long long start = profiling ? profiler.Now () : 0;
+
+		{
+			AllocationScope scope (_allocations);
+			for (size_t root : _tasks.Roots ()){
+				SpawnUpdate (root);
+			}
+			_frame.Wait ();
+		}
+		_tasks.EndFrame ();
+
+#		ifndef NDEBUG
+		// the profiler allocates its buffers as threads first record
+		if (++_steadyFrames > SIM_TASK_WARMUP_FRAMES && !profiling && _allocations.Count () > 0){
+			LOG_ERROR (_allocations.Count () << " heap allocations in steady-state frame " << _steadyFrames);
+			assert (_allocations.Count () == 0);
+		}
+		_allocations.Reset ();
+#		endif
+
+		if (profiling){
+			profiler.EndFrame (start, _tasks);
+		}
+	}
+
+	void ThreadManager::SpawnUpdate (size_t index)
+	{
+		_frame._pending.fetch_add (1, std::memory_order_relaxed);
+		Spawn (&_graphTasks [index]);
+	}
+
+	void ThreadManager::RunTask (size_t index)
+	{
+		AllocationScope scope (_allocations);
+		while (true){
+			_tasks.Run (index);
+
+			// spawn the successors made ready, except one that runs next on this thread
+			size_t next = SIZE_MAX;
+			for (size_t s : _tasks.Task (index)._successors){
+				if (_waiting [s].fetch_sub (1, std::memory_order_acq_rel) == 1){
+					if (next == SIZE_MAX){
+						next = s;
+					}
+					else {
+						SpawnUpdate (s);
+					}
+				}
+			}
+			if (next == SIZE_MAX){
+				return;
+			}
+			index = next;
+		}
+	}
+
+	void ThreadManager::Enqueue (std::function <void ()> work)
+	{
+		if (!_running){
+			work ();
+			return;
+		}
+		// not part of the frame, even when a worker takes it up while waiting on one
+		_background.Run ([work = std::move (work)] () {
+			AllocationScope uncounted;
+			work ();
+		});
+	}
+
+	void ThreadManager::ParallelFor (size_t begin, size_t end, const RangeTask& task, size_t grain)
+	{
+		if (begin >= end){
+			return;
+		}
+		if (grain == 0){
+			grain = (end - begin)/(SIM_TASK_SPLITS_PER_WORKER*Concurrency ());
+			if (grain == 0){
+				grain = 1;
+			}
+		}
+
+		TaskGroup group (*this);
+		SplitRange (group, begin, end, task, grain);
+		group.Wait ();
+	}
+
+	void ThreadManager::SplitRange (TaskGroup& group, size_t begin, size_t end, const RangeTask& task, size_t grain)
+	{
+		// hand the upper halves out for stealing and keep the lower one
+		while (end - begin > grain){
+			size_t middle = begin + (end - begin)/2;
+			group.Run ([this, &group, &task, middle, end, grain] () {
+				SplitRange (group, middle, end, task, grain);
+			});
+			end = middle;
+		}
+		task (begin, end);
+	}
+
+	int ThreadManager::LocalIndex () const
+	{
+		return local._instance == _instance ? local._index : -1;
+	}
+
+	void ThreadManager::Spawn (Task* task)
+	{
+		int index = LocalIndex ();
+		if (index >= 0 && _running){
+			_workers [index]->_deque.Push (task);
+		}
+		else {
+			std::lock_guard <std::mutex> loki (_injectedMutex);
+			_injected.push_back (task);
+			_injectedCount.fetch_add (1, std::memory_order_seq_cst);
+		}
+
+		if (_sleeping.load (std::memory_order_seq_cst) > 0){
+			_wake.notify_one ();
+		}
+	}
+
+	bool ThreadManager::RunOne ()
+	{
+		Task* task = nullptr;
+		int index = LocalIndex ();
+		bool found = index >= 0 && _running && _workers [index]->_deque.Pop (task);
+
+		// steal, starting with a random victim
+		unsigned int count = static_cast <unsigned int> (_workers.size ());
+		if (!found && _running && count > 1){
+			unsigned int start = 0;
+			if (index >= 0){
+				unsigned int& seed = _workers [index]->_seed;
+				seed = seed*1103515245 + 12345;
+				start = (seed >> 16) % count;
+			}
+			for (unsigned int i = 0; i < count && !found; ++i){
+				unsigned int victim = (start + i) % count;
+				if (static_cast <int> (victim) != index){
+					found = _workers [victim]->_deque.Steal (task);
+					if (found && TaskProfiler::Instance ().IsEnabled ()){
+						long long now = TaskProfiler::Instance ().Now ();
+						TaskProfiler::Instance ().Record (TraceType::Steal, nullptr, now, now, victim);
+					}
+				}
+			}
+		}
+
+		if (!found && _injectedCount.load (std::memory_order_seq_cst) > 0){
+			std::lock_guard <std::mutex> loki (_injectedMutex);
+			if (!_injected.empty ()){
+				task = _injected.front ();
+				_injected.pop_front ();
+				_injectedCount.fetch_sub (1, std::memory_order_relaxed);
+				found = true;
+			}
+		}
+		if (!found){
+			return false;
+		}
+
+		task->_run (task->_work);
+		TaskGroup* group = task->_group;
+		if (!task->_persistent){
+			delete task;
+		}
+		// the group may be gone as soon as this is seen
+		group->_pending.fetch_sub (1, std::memory_order_release);
+		return true;
+	}
+
+	bool ThreadManager::HasWork () const
+	{
+		if (_injectedCount.load (std::memory_order_seq_cst) > 0){
+			return true;
+		}
+		for (auto& w : _workers){
+			if (!w->_deque.Empty ()){
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void ThreadManager::Idle ()
+	{
+		TaskProfiler& profiler = TaskProfiler::Instance ();
+		long long start = profiler.IsEnabled () ? profiler.Now () : -1;
+
+		bool work = false;
+		for (unsigned int i = 0; i < SIM_TASK_IDLE_SPINS && !work; ++i){
+			work = HasWork () || !_running;
+			if (!work){
+				std::this_thread::yield ();
+			}
+		}
+
+		if (!work){
+			std::unique_lock <std::mutex> loki (_sleepMutex);
+			_sleeping.fetch_add (1, std::memory_order_seq_cst);
+			// checked after announcing the sleep, so a spawn is either seen here or wakes us up
+			// (the timeout covers a push to a deque that is not visible yet)
+			if (!HasWork () && _running){
+				_wake.wait_for (loki, std::chrono::milliseconds (1));
+			}
+			_sleeping.fetch_sub (1, std::memory_order_seq_cst);
+		}
+
+		if (start >= 0){
+			profiler.Record (TraceType::Idle, nullptr, start, profiler.Now ());
+		}
+	}
+
+	void ThreadManager::WorkerLoop (unsigned int index)
+	{
+		local._instance = _instance;
+		local._index = static_cast <int> (index);
+		TaskProfiler::Instance ().NameThread ("Worker " + std::to_string (index));
+		if (_placement.IsPinned ()){
+			PinThread (_placement.WorkerCpus (index - 1));
+		}
+		// the first task a thread spawns sets up its pool magazine, better now than in a frame
+		delete new Task;
+
+		// events raised by tasks go to this worker's outbox
+		EventManager* events = Driver::Instance ().GetEventManager ();
+		if (events != nullptr){
+			events->AttachThread ();
+		}
+
+		while (_running){
+			if (!RunOne ()){
+				Idle ();
+			}
+		}
+
+		if (events != nullptr){
+			events->DetachThread ();
+		}
+		local._instance = 0;
+		local._index = -1;
+	}
+}
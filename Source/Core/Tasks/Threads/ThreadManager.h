@@ -0,0 +1,206 @@
+/**
+ * @file ThreadManager.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * The std::thread task manager, for builds without Intel TBB. It is a
+ * work-stealing scheduler: every worker owns a Chase-Lev deque, runs its
+ * own tasks newest first and steals the oldest tasks of a random victim
+ * when it runs dry. Threads that are not workers hand their tasks over
+ * through a locked injection queue. The thread that initializes the manager
+ * is worker 0 and takes part in the work whenever it waits. Idle workers
+ * spin briefly before they sleep. Tasks are spawned into a TaskGroup and
+ * waited for with TaskGroup::Wait (), which runs other tasks in the
+ * meantime. ParallelFor () splits its range in halves down to a grain
+ * adapted to the range size and the number of workers, so stolen halves get
+ * split further. Update () runs the task graph read from a TbbConfig.xml
+ * style config: an update is spawned once its last dependency is done, and
+ * a finishing task carries on with one of the updates it made ready. The
+ * graph is compiled into one task per update at initialization (and again
+ * when the assets change), so a frame only resets the dependency counters
+ * and spawns the roots. Tasks keep their work inline, so neither frames nor
+ * parallel loops allocate; debug builds check that steady-state frames do
+ * not. Lanes with rates of their own run next to it (see
+ * Tasks/RateScheduler.h). With a Threads element in the config, the calling
+ * thread and the workers are pinned to their processors (see
+ * Tasks/ThreadPlacement.h), and unless a concurrency is given there is one
+ * worker per processor of the workers. Blocking jobs go to the I/O threads
+ * (see Tasks/IOExecutor.h), whose continuations come back as background
+ * tasks.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "WorkStealingDeque.h"
+#include "Memory/Memory.h"
+#include "Memory/AllocationCounter.h"
+#include "Tasks/TaskManager.h"
+#include "Tasks/TaskGraph.h"
+#include "Tasks/RateScheduler.h"
+#include "Tasks/ThreadPlacement.h"
+
+namespace Sim {
+
+	// ranges a parallel loop is split into per worker, when no grain is given
+	const unsigned int SIM_TASK_SPLITS_PER_WORKER = 4;
+	// attempts to find work before an idle worker goes to sleep
+	const unsigned int SIM_TASK_IDLE_SPINS = 64;
+	// bytes of work a task holds without a heap allocation
+	const size_t SIM_TASK_INLINE_SIZE = 64;
+
+	class ThreadManager;
+
+	class TaskGroup {
+
+			friend class ThreadManager;
+
+		private:
+			ThreadManager& _manager;
+			std::atomic <size_t> _pending {0};
+
+		public:
+			explicit TaskGroup (ThreadManager& manager): _manager (manager) {}
+			~TaskGroup () {Wait ();}
+
+			TaskGroup (const TaskGroup&) = delete;
+			TaskGroup& operator = (const TaskGroup&) = delete;
+
+			template <class F> void Run (F&& work);
+			// returns once all tasks of the group are done, running tasks meanwhile
+			void Wait ();
+	};
+
+	class ThreadManager : public TaskManager {
+
+			friend class TaskGroup;
+
+		private:
+			struct Task : public Pooled <Task> {
+				// the work, in _storage when it fits
+				typename std::aligned_storage <SIM_TASK_INLINE_SIZE, alignof (std::max_align_t)>::type _storage;
+				void* _work = nullptr;
+				void (*_run) (void*) = nullptr;
+				void (*_destroy) (Task&) = nullptr;
+
+				TaskGroup* _group = nullptr;
+				// tasks of the compiled graph are run every frame and never deleted
+				bool _persistent = false;
+
+				Task () = default;
+				~Task () {if (_work != nullptr) _destroy (*this);}
+
+				template <class F> void Bind (F&& work);
+			};
+
+			struct Worker {
+				WorkStealingDeque <Task*> _deque;
+				std::thread _thread;
+				// state of the victim picker
+				unsigned int _seed = 1;
+			};
+
+			// identifies this manager in the worker index cached by each thread
+			unsigned int _instance;
+			// requested number of workers, 0 for one per hardware thread
+			unsigned int _concurrency;
+			ThreadPlacement _placement;
+			std::vector <std::unique_ptr <Worker> > _workers;
+			std::atomic <bool> _running {false};
+
+			// tasks spawned by threads that are not workers
+			std::mutex _injectedMutex;
+			std::deque <Task*> _injected;
+			std::atomic <size_t> _injectedCount {0};
+
+			std::mutex _sleepMutex;
+			std::condition_variable _wake;
+			std::atomic <unsigned int> _sleeping {0};
+
+			TaskGraph _tasks;
+			// lanes running at their own rates, next to the frame
+			RateScheduler _rates;
+			// dependencies of each update still to run this frame
+			std::unique_ptr <std::atomic <unsigned int> []> _waiting;
+			// one task per update, and the group the frame runs them in
+			std::unique_ptr <Task []> _graphTasks;
+			TaskGroup _frame;
+			// tasks enqueued from outside the frame, continuations of I/O jobs etc.
+			TaskGroup _background;
+
+			// heap allocations of the frame, and frames since the graph was compiled
+			AllocationCounter _allocations;
+			unsigned int _steadyFrames = 0;
+
+		public:
+			explicit ThreadManager (unsigned int concurrency = 0);
+			~ThreadManager ();
+
+			ThreadManager (const ThreadManager&) = delete;
+			ThreadManager& operator = (const ThreadManager&) = delete;
+
+			bool Initialize (const char* config) override;
+			void Update () override;
+			void Cleanup () override;
+			void ParallelFor (size_t begin, size_t end, const RangeTask& task, size_t grain = 0) override;
+			bool LaneStats (const char* name, RateStats& stats) const override {return _rates.Stats (name, stats);}
+			void Enqueue (std::function <void ()> work) override;
+
+			// number of workers, including the thread that initialized the manager
+			unsigned int Concurrency () const override {return _workers.empty () ? 1 : static_cast <unsigned int> (_workers.size ());}
+
+		private:
+			void Spawn (Task*);
+			// runs one task if one can be found
+			bool RunOne ();
+			bool HasWork () const;
+			void Idle ();
+			void WorkerLoop (unsigned int index);
+			int LocalIndex () const;
+
+			// turns the graph into persistent tasks
+			void Compile ();
+			void SpawnUpdate (size_t index);
+			void RunTask (size_t index);
+			void SplitRange (TaskGroup&, size_t begin, size_t end, const RangeTask&, size_t grain);
+	};
+
+	template <class F> void ThreadManager::Task::Bind (F&& work)
+	{
+		typedef typename std::decay <F>::type Work;
+		bool inlined = sizeof (Work) <= sizeof (_storage) && alignof (Work) <= alignof (decltype (_storage));
+		_work = inlined ? new (&_storage) Work (std::forward <F> (work)) : new Work (std::forward <F> (work));
+		_run = [] (void* w) {(*static_cast <Work*> (w)) ();};
+		_destroy = [] (Task& task) {
+			Work* w = static_cast <Work*> (task._work);
+			if (task._work == &task._storage){
+				w->~Work ();
+			}
+			else {
+				delete w;
+			}
+			task._work = nullptr;
+		};
+	}
+
+	template <class F> void TaskGroup::Run (F&& work)
+	{
+		ThreadManager::Task* task = new ThreadManager::Task;
+		task->Bind (std::forward <F> (work));
+		task->_group = this;
+		_pending.fetch_add (1, std::memory_order_relaxed);
+		_manager.Spawn (task);
+	}
+}
@@ -0,0 +1,142 @@
+/**
+ * @file WorkPartition.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See WorkPartition.h.
+ */
+
+#include <algorithm>
+#include <functional>
+
+#include "Tasks/WorkPartition.h"
+
+namespace Sim {
+
+	void WorkPartition::Initialize (const std::vector <double>& weights)
+	{
+		Cleanup ();
+		size_t count = weights.size ();
+		_weights = weights;
+		_costs.assign (count, 0.0);
+		_measured.reset (new double [count]);
+		std::fill (_measured.get (), _measured.get () + count, -1.0);
+
+		_order.resize (count);
+		_binStarts.reserve (count + 1);
+		_byCost.resize (count);
+		_itemCosts.resize (count);
+		_binOf.resize (count);
+		_loads.reserve (count);
+		_binLoads.resize (count);
+		_ranked.resize (count);
+		_cursors.resize (count);
+	}
+
+	void WorkPartition::Cleanup ()
+	{
+		_weights.clear ();
+		_costs.clear ();
+		_measured.reset ();
+		_perWeight = 0.0;
+		_order.clear ();
+		_binStarts.clear ();
+		_makespan = _meanLoad = 0.0;
+		_passes = 0;
+
+		_byCost.clear ();
+		_itemCosts.clear ();
+		_binOf.clear ();
+		_loads.clear ();
+		_binLoads.clear ();
+		_ranked.clear ();
+		_cursors.clear ();
+	}
+
+	double WorkPartition::Cost (size_t item) const
+	{
+		if (_costs [item] > 0.0){
+			return _costs [item];
+		}
+		return _perWeight > 0.0 ? _weights [item]*_perWeight : _weights [item];
+	}
+
+	void WorkPartition::Balance (unsigned int bins)
+	{
+		size_t size = _weights.size ();
+		size_t count = std::min <size_t> (std::max (bins, 1u), size);
+		for (size_t i = 0; i < size; ++i){
+			_byCost [i] = i;
+			_itemCosts [i] = Cost (i);
+		}
+		// ties in item order (std::stable_sort would allocate)
+		const std::vector <double>& costs = _itemCosts;
+		std::sort (_byCost.begin (), _byCost.end (), [&costs] (size_t a, size_t b) {
+			return costs [a] != costs [b] ? costs [a] > costs [b] : a < b;
+		});
+
+		// largest first, each to the least loaded bin (a min-heap of the bin loads)
+		typedef std::pair <double, size_t> Load;
+		_loads.clear ();
+		for (size_t b = 0; b < count; ++b){
+			_loads.push_back (Load (0.0, b));
+			_binLoads [b] = 0.0;
+			_cursors [b] = 0;
+		}
+		for (size_t item : _byCost){
+			std::pop_heap (_loads.begin (), _loads.end (), std::greater <Load> ());
+			Load& least = _loads.back ();
+			_binOf [item] = least.second;
+			++_cursors [least.second];
+			least.first = _binLoads [least.second] += costs [item];
+			std::push_heap (_loads.begin (), _loads.end (), std::greater <Load> ());
+		}
+
+		// the heaviest bins first, so they start first
+		const std::vector <double>& loads = _binLoads;
+		for (size_t b = 0; b < count; ++b){
+			_ranked [b] = b;
+		}
+		std::sort (_ranked.begin (), _ranked.begin () + count, [&loads] (size_t a, size_t b) {
+			return loads [a] != loads [b] ? loads [a] > loads [b] : a < b;
+		});
+
+		// bin starts from the bin sizes, then the items in cost order into their bins
+		_binStarts.assign (1, 0);
+		double sum = 0.0;
+		for (size_t r = 0; r < count; ++r){
+			size_t b = _ranked [r];
+			size_t start = _binStarts.back ();
+			_binStarts.push_back (start + _cursors [b]);
+			_cursors [b] = start;
+			sum += loads [b];
+		}
+		for (size_t item : _byCost){
+			_order [_cursors [_binOf [item]]++] = item;
+		}
+		_makespan = count > 0 ? loads [_ranked [0]] : 0.0;
+		_meanLoad = count > 0 ? sum/count : 0.0;
+	}
+
+	void WorkPartition::EndPass ()
+	{
+		double time = 0.0, weight = 0.0;
+		for (size_t i = 0; i < _weights.size (); ++i){
+			double measured = _measured [i];
+			if (measured < 0.0){
+				continue;
+			}
+			_measured [i] = -1.0;
+			_costs [i] = _costs [i] > 0.0 ? _costs [i] + SIM_TASK_COST_SMOOTHING*(measured - _costs [i]) : measured;
+			time += measured;
+			weight += _weights [i];
+		}
+		if (weight > 0.0){
+			double perWeight = time/weight;
+			_perWeight = _perWeight > 0.0 ? _perWeight + SIM_TASK_COST_SMOOTHING*(perWeight - _perWeight) : perWeight;
+		}
+		++_passes;
+	}
+}
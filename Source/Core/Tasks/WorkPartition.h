@@ -0,0 +1,92 @@
+/**
+ * @file WorkPartition.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Cost model of a loop over items of very uneven size, like the spatial
+ * subsets of a Geometry. Every item starts with a static weight (its
+ * triangle, vertex or spring count etc.), and once it ran its measured
+ * time takes over, smoothed over the passes. Items never measured are
+ * estimated from their weight at the time per weight unit measured on the
+ * others. Before each pass, Balance () hands the items out to as many bins
+ * as there are workers, largest first to the least loaded bin (LPT), so a
+ * dense item gets a bin of its own instead of finishing late on a shared
+ * one. TaskManager::PartitionedFor () runs and times the bins. A partition
+ * serves one loop at a time, and balancing does not allocate once it is
+ * initialized. TestKitchen/PartitionBenchmark compares balanced passes
+ * with static ranges.
+ */
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace Sim {
+
+	// weight of the latest pass (or frame) in the measured times
+	const double SIM_TASK_COST_SMOOTHING = 0.1;
+
+	class WorkPartition {
+
+		private:
+			std::vector <double> _weights;
+			// smoothed time in microseconds, zero until measured
+			std::vector <double> _costs;
+			// time of the current pass, written by the thread running the item
+			std::unique_ptr <double []> _measured;
+			// fitted time per weight unit, zero until any item was measured
+			double _perWeight = 0.0;
+
+			// items grouped by bin, bins by decreasing load
+			std::vector <size_t> _order;
+			std::vector <size_t> _binStarts;
+			// predicted longest and mean bin load of the last balance
+			double _makespan = 0.0;
+			double _meanLoad = 0.0;
+			unsigned int _passes = 0;
+
+			// scratch of Balance (), sized by Initialize (): there are at most as many bins as items
+			std::vector <size_t> _byCost;
+			std::vector <double> _itemCosts;
+			std::vector <size_t> _binOf;
+			std::vector <std::pair <double, size_t> > _loads;
+			std::vector <double> _binLoads;
+			std::vector <size_t> _ranked;
+			std::vector <size_t> _cursors;
+
+		public:
+			WorkPartition () = default;
+			~WorkPartition () = default;
+
+			WorkPartition (const WorkPartition&) = delete;
+			WorkPartition& operator = (const WorkPartition&) = delete;
+
+			// one weight per item, forgetting the measured costs
+			void Initialize (const std::vector <double>& weights);
+			void Cleanup ();
+
+			size_t Size () const {return _weights.size ();}
+			unsigned int Passes () const {return _passes;}
+			// estimated time (in weight units until anything was measured)
+			double Cost (size_t item) const;
+
+			// assigns the items to at most 'bins' bins
+			void Balance (unsigned int bins);
+			size_t Bins () const {return _binStarts.empty () ? 0 : _binStarts.size () - 1;}
+			// items of bin 'bin' are Item (BinBegin (bin)) to Item (BinEnd (bin) - 1)
+			size_t BinBegin (size_t bin) const {return _binStarts [bin];}
+			size_t BinEnd (size_t bin) const {return _binStarts [bin + 1];}
+			size_t Item (size_t index) const {return _order [index];}
+			// predicted longest bin over the mean bin of the last balance (1 is perfect)
+			double Imbalance () const {return _meanLoad > 0.0 ? _makespan/_meanLoad : 1.0;}
+
+			// time taken by 'item' in this pass
+			void Record (size_t item, double microseconds) {_measured [item] = microseconds;}
+			// folds the times of the pass into the costs
+			void EndPass ();
+	};
+}
@@ -0,0 +1,170 @@
+/**
+ * @file main.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Throughput benchmark for the event queues. 1..N producer threads push
+ * events while a single consumer (the event manager's dispatch thread)
+ * drains them. Compared are the former mutex/condition-variable queue,
+ * the blocking CircularQueue wrapper and the lock-free RingBuffer with
+ * batched PopN (). Results are in million events per second.
+ * Usage: ./Bin/eventqbench [max producer threads]
+ */
+
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "RingBuffer.h"
+#include "CircularQueue.h"
+#include "Events/Event.h"
+
+using std::cout;
+using std::endl;
+using std::setw;
+using std::vector;
+using std::thread;
+
+using Sim::Event;
+using Sim::EventType;
+
+static const unsigned int QueueSize = 1024;
+static const unsigned int BatchSize = 64;
+static const unsigned int EventsPerProducer = 1 << 20;
+
+// the queue the event manager used before: mutex, two condition variables and modulo indexing
+template <class T, unsigned int size> class MutexQueue {
+
+	private:
+		std::mutex _mutex;
+		std::condition_variable _full, _empty;
+		unsigned int _readIndex = 0;
+		unsigned int _writeIndex = 0;
+		T _queue [size];
+
+	public:
+		void Push (const T& e)
+		{
+			std::unique_lock <std::mutex> loki (_mutex);
+			while ((_writeIndex + 1) % size == _readIndex){
+				_full.wait (loki);
+			}
+			_queue [_writeIndex] = e;
+			_writeIndex = (_writeIndex + 1) % size;
+			_empty.notify_one ();
+		}
+
+		void Pop (T& result)
+		{
+			std::unique_lock <std::mutex> loki (_mutex);
+			while (_writeIndex == _readIndex){
+				_empty.wait (loki);
+			}
+			result = _queue [_readIndex];
+			_readIndex = (_readIndex + 1) % size;
+			_full.notify_one ();
+		}
+};
+
+// adapters giving all queues the same producer/consumer interface
+template <class Queue> struct Blocking {
+	Queue _queue;
+	void Produce (const Event& e) {_queue.Push (e);}
+	unsigned int Consume (Event* e) {_queue.Pop (e [0]); return 1;}
+};
+
+struct LockFree {
+	Sim::RingBuffer <Event, QueueSize> _queue;
+	void Produce (const Event& e)
+	{
+		while (!_queue.TryPush (e)){
+			std::this_thread::yield ();
+		}
+	}
+	unsigned int Consume (Event* e)
+	{
+		unsigned int n = _queue.PopN (e, BatchSize);
+		if (n == 0){
+			std::this_thread::yield ();
+		}
+		return n;
+	}
+};
+
+// runs 'producers' producer threads against one consumer and returns million events per second
+template <class Queue> double Benchmark (unsigned int producers)
+{
+	std::unique_ptr <Queue> queue (new Queue);
+	size_t total = size_t (producers)*EventsPerProducer;
+	std::atomic <size_t> checksum {0};
+
+	auto start = std::chrono::steady_clock::now ();
+
+	thread consumer ([&] () {
+		Event events [BatchSize];
+		size_t sum = 0;
+		for (size_t consumed = 0; consumed < total;){
+			unsigned int n = queue->Consume (events);
+			for (unsigned int i = 0; i < n; ++i){
+				sum += events [i]._assetId;
+			}
+			consumed += n;
+		}
+		checksum = sum;
+	});
+
+	vector <thread> workers;
+	for (unsigned int p = 0; p < producers; ++p){
+		workers.emplace_back ([&queue, p] () {
+			for (unsigned int i = 0; i < EventsPerProducer; ++i){
+				queue->Produce (Event (p, EventType::EVENT_PHYSICS));
+			}
+		});
+	}
+	for (auto& w : workers){
+		w.join ();
+	}
+	consumer.join ();
+
+	std::chrono::duration <double> elapsed = std::chrono::steady_clock::now () - start;
+
+	size_t expected = size_t (producers)*(producers - 1)/2*EventsPerProducer;
+	if (checksum != expected){
+		cout << "Events lost or duplicated" << endl;
+		exit (EXIT_FAILURE);
+	}
+	return double (total)/elapsed.count ()*1e-6;
+}
+
+int main (int argc, const char** argv)
+{
+	unsigned int maxThreads = thread::hardware_concurrency ();
+	if (argc > 1){
+		maxThreads = static_cast <unsigned int> (atoi (argv [1]));
+	}
+	if (maxThreads == 0){
+		maxThreads = 1;
+	}
+
+	cout << "Queue size: " << QueueSize << ", " << EventsPerProducer << " events per producer, one consumer" << endl;
+	cout << "Throughput in million events per second" << endl;
+	cout << setw (10) << "Producers" << setw (14) << "Mutex" << setw (14) << "Circular" << setw (14) << "RingBuffer" << endl;
+
+	for (unsigned int t = 1; t <= maxThreads; t = t < maxThreads && 2*t > maxThreads ? maxThreads : 2*t){
+		cout << std::fixed << std::setprecision (2) << setw (10) << t
+				<< setw (14) << Benchmark <Blocking <MutexQueue <Event, QueueSize> > > (t)
+				<< setw (14) << Benchmark <Blocking <Sim::CircularQueue <Event, QueueSize> > > (t)
+				<< setw (14) << Benchmark <LockFree> (t) << endl;
+	}
+
+	exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,184 @@
+/**
+ * @file main.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Checks and benchmark of the WorkPartition cost model. The checks make
+ * sure a dense item gets a bin of its own, that EndPass () folds the
+ * measured times into the costs, and that Balance () does not allocate.
+ * The benchmark runs a loop of 64 sleeping items, 4 of them 17 times
+ * longer than the others and seeded with the same weight, on N threads:
+ * once split into static contiguous ranges, and over several passes
+ * balanced the way TaskManager::PartitionedFor () does. Times are in
+ * milliseconds per pass.
+ * Usage: ./Bin/partitionbench [threads] [passes]
+ */
+
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "Tasks/WorkPartition.h"
+
+using std::cout;
+using std::endl;
+using std::setw;
+using std::vector;
+using std::thread;
+
+using Sim::WorkPartition;
+
+using std::chrono::steady_clock;
+
+static const unsigned int Items = 64;
+static const unsigned int DenseStride = 4;
+static const unsigned int DenseItems = 4;
+static const std::chrono::microseconds LightTime (375);
+static const std::chrono::microseconds DenseTime (6375);
+
+// allocations so far, to check that balancing does not allocate
+static std::atomic <size_t> allocations {0};
+
+void* operator new (size_t size)
+{
+	++allocations;
+	void* p = malloc (size ? size : 1);
+	if (p == nullptr){
+		throw std::bad_alloc ();
+	}
+	return p;
+}
+
+void operator delete (void* p) noexcept
+{
+	free (p);
+}
+
+void operator delete (void* p, size_t) noexcept
+{
+	free (p);
+}
+
+static void Check (bool condition, const char* what)
+{
+	cout << (condition ? "passed: " : "FAILED: ") << what << endl;
+	if (!condition){
+		exit (EXIT_FAILURE);
+	}
+}
+
+static bool IsDense (size_t item)
+{
+	return item % DenseStride == 0 && item/DenseStride < DenseItems;
+}
+
+static void RunChecks ()
+{
+	WorkPartition partition;
+	partition.Initialize (vector <double> {10.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0});
+
+	size_t before = allocations.load ();
+	partition.Balance (3);
+	partition.Balance (2);
+	Check (allocations.load () == before, "Balance () does not allocate");
+
+	partition.Balance (3);
+	bool alone = false;
+	for (size_t b = 0; b < partition.Bins (); ++b){
+		if (partition.Item (partition.BinBegin (b)) == 0){
+			alone = partition.BinEnd (b) - partition.BinBegin (b) == 1;
+		}
+	}
+	Check (partition.Bins () == 3 && alone, "the dense item has a bin of its own");
+	Check (partition.BinBegin (0) == 0 && partition.Item (0) == 0, "the heaviest bin comes first");
+
+	// item 1 turns out dense, the others are not measured
+	partition.Record (0, 100.0);
+	partition.Record (1, 400.0);
+	partition.EndPass ();
+	Check (partition.Cost (0) == 100.0 && partition.Cost (1) == 400.0, "EndPass () takes the first measured times");
+	Check (partition.Cost (2) == 500.0/11.0, "unmeasured items are estimated from the time per weight");
+
+	partition.Record (1, 200.0);
+	partition.EndPass ();
+	Check (partition.Cost (1) == 400.0 + Sim::SIM_TASK_COST_SMOOTHING*(200.0 - 400.0), "EndPass () smooths later times");
+	Check (partition.Passes () == 2, "passes are counted");
+
+	partition.Balance (3);
+	Check (partition.Item (0) == 1 && partition.BinEnd (0) == 1, "the measured dense item gets a bin of its own");
+}
+
+static void Work (size_t item)
+{
+	std::this_thread::sleep_for (IsDense (item) ? DenseTime : LightTime);
+}
+
+// runs 'bins' of items on 'threads' threads, an idle thread takes the next bin. Returns the milliseconds taken
+template <class Bin> double RunPass (unsigned int threads, size_t bins, const Bin& bin)
+{
+	std::atomic <size_t> next {0};
+	auto start = steady_clock::now ();
+	vector <thread> workers;
+	for (unsigned int i = 0; i < threads; ++i){
+		workers.emplace_back ([&next, bins, &bin] () {
+			for (size_t b = next++; b < bins; b = next++){
+				bin (b);
+			}
+		});
+	}
+	for (auto& w : workers){
+		w.join ();
+	}
+	return std::chrono::duration <double, std::milli> (steady_clock::now () - start).count ();
+}
+
+int main (int argc, char** argv)
+{
+	unsigned int threads = argc > 1 ? static_cast <unsigned int> (atoi (argv [1])) : 4;
+	unsigned int passes = argc > 2 ? static_cast <unsigned int> (atoi (argv [2])) : 8;
+	if (threads == 0 || passes == 0){
+		cout << "Usage: " << argv [0] << " [threads] [passes]" << endl;
+		exit (EXIT_FAILURE);
+	}
+
+	RunChecks ();
+
+	double total = DenseItems*DenseTime.count () + (Items - DenseItems)*LightTime.count ();
+	cout << endl << Items << " items (" << DenseItems << " dense) on " << threads << " threads, ideal pass "
+		<< total/threads*1e-3 << " ms" << endl;
+
+	// contiguous ranges of the same item count
+	double ranges = RunPass (threads, threads, [threads] (size_t b) {
+		for (size_t i = b*Items/threads; i < (b + 1)*Items/threads; ++i){
+			Work (i);
+		}
+	});
+	cout << setw (24) << "static ranges: " << ranges << " ms" << endl;
+
+	// every item seeded with the same weight, the dense ones are found by timing them
+	WorkPartition partition;
+	partition.Initialize (vector <double> (Items, 1.0));
+	for (unsigned int p = 0; p < passes; ++p){
+		partition.Balance (threads);
+		double time = RunPass (threads, partition.Bins (), [&partition] (size_t b) {
+			for (size_t i = partition.BinBegin (b); i < partition.BinEnd (b); ++i){
+				size_t item = partition.Item (i);
+				auto start = steady_clock::now ();
+				Work (item);
+				partition.Record (item, std::chrono::duration <double, std::micro> (steady_clock::now () - start).count ());
+			}
+		});
+		partition.EndPass ();
+		cout << setw (18) << "balanced pass " << setw (2) << p + 1 << ": " << time << " ms (predicted imbalance "
+			<< partition.Imbalance () << ")" << endl;
+	}
+
+	exit (EXIT_SUCCESS);
+}
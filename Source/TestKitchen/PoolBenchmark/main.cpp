@@ -0,0 +1,111 @@
+/**
+ * @file main.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Contention benchmark for the memory pools. Every thread repeatedly
+ * allocates a burst of pages, writes to them and frees them again. The
+ * mutex-guarded MemoryPool, the thread-caching MagazinePool and the
+ * lock-free ConcurrentMemoryPool are run with 1..N threads and their
+ * throughput is reported in million allocate/free pairs per second.
+ * Usage: ./Bin/poolbench [max threads] [page size]
+ */
+
+#include <cstdlib>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "Memory/MemoryPool.h"
+#include "Memory/MagazinePool.h"
+#include "Memory/ConcurrentMemoryPool.h"
+
+using std::cout;
+using std::endl;
+using std::setw;
+using std::vector;
+using std::thread;
+
+using Sim::MemoryPool;
+using Sim::MagazinePool;
+using Sim::ConcurrentMemoryPool;
+
+static const unsigned int BurstSize = 64;
+static const unsigned int Iterations = 20000;
+
+// runs the burst workload on 'threads' threads and returns million pairs per second
+template <class Pool> double Run (Pool& pool, unsigned int threads, unsigned int pageSize)
+{
+	auto work = [&pool, pageSize] () {
+		void* pages [BurstSize];
+		for (unsigned int i = 0; i < Iterations; ++i){
+			for (unsigned int j = 0; j < BurstSize; ++j){
+				pages [j] = pool.Allocate ();
+				if (pages [j] == nullptr){
+					cout << "Pool exhausted" << endl;
+					exit (EXIT_FAILURE);
+				}
+				static_cast <unsigned char*> (pages [j]) [pageSize - 1] = static_cast <unsigned char> (j);
+			}
+			for (unsigned int j = 0; j < BurstSize; ++j){
+				pool.Free (pages [BurstSize - j - 1]);
+			}
+		}
+	};
+
+	auto start = std::chrono::steady_clock::now ();
+
+	vector <thread> workers;
+	for (unsigned int i = 0; i < threads; ++i){
+		workers.emplace_back (work);
+	}
+	for (auto& w : workers){
+		w.join ();
+	}
+
+	std::chrono::duration <double> elapsed = std::chrono::steady_clock::now () - start;
+	return double (threads)*Iterations*BurstSize/elapsed.count ()*1e-6;
+}
+
+template <class Pool> double Benchmark (unsigned int threads, unsigned int pageSize)
+{
+	Pool pool;
+	pool.AllowResize (true);
+	if (!pool.Initialize (pageSize, BurstSize*threads)){
+		cout << "Could not initialize pool" << endl;
+		exit (EXIT_FAILURE);
+	}
+	return Run (pool, threads, pageSize);
+}
+
+int main (int argc, const char** argv)
+{
+	unsigned int maxThreads = thread::hardware_concurrency ();
+	unsigned int pageSize = 64;
+	if (argc > 1){
+		maxThreads = static_cast <unsigned int> (atoi (argv [1]));
+	}
+	if (argc > 2){
+		pageSize = static_cast <unsigned int> (atoi (argv [2]));
+	}
+	if (maxThreads == 0){
+		maxThreads = 1;
+	}
+
+	cout << "Page size: " << pageSize << " bytes, " << Iterations << " bursts of " << BurstSize << " pages per thread" << endl;
+	cout << "Throughput in million allocate/free pairs per second" << endl;
+	cout << setw (8) << "Threads" << setw (14) << "MemoryPool" << setw (14) << "MagazinePool" << setw (14) << "Concurrent" << endl;
+
+	for (unsigned int t = 1; t <= maxThreads; t = t < maxThreads && 2*t > maxThreads ? maxThreads : 2*t){
+		cout << std::fixed << std::setprecision (2) << setw (8) << t
+				<< setw (14) << Benchmark <MemoryPool> (t, pageSize)
+				<< setw (14) << Benchmark <MagazinePool> (t, pageSize)
+				<< setw (14) << Benchmark <ConcurrentMemoryPool> (t, pageSize) << endl;
+	}
+
+	exit (EXIT_SUCCESS);
+}
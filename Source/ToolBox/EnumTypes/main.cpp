@@ -148,7 +148,7 @@ int main (int argc, const char** argv)
 			file << "\t }" << endl << endl;
 
 			// STRING TO ENUM CONVERTER LAMBDA FUNCTION
-			file << "\t auto " << name << "ByName = [=] (const char* chr)" << endl;
+			file << "\t static auto " << name << "ByName = [] (const char* chr)" << endl;
 			file << "\t {" << endl;
 			file << "\t\t string str (chr);" << endl;
 
@@ -74,10 +74,7 @@ namespace Sim {
 
 		// write out texture file and deallocate data
 		WriteTexFile (".rgba.tex3", _rgb);
-		for (unsigned int i = 0; i < _rgb.size (); ++i){
-			_rgb [i].clear ();
-		}
-		_rgb.clear ();
+		_rgb.reset ();
 
 		if (!ProcessCT (nlabels, labels)){
 			LOG_ERROR ("CT data could not be successfully processed");
@@ -86,17 +83,11 @@ namespace Sim {
 		}
 
 		WriteTexFile (".ct.tex3", _ct);
-		for (unsigned int i = 0; i < _ct.size (); ++i){
-			_ct [i].clear ();
-		}
-		_ct.clear ();
+		_ct.reset ();
 
 		// write out the mask volume
 		WriteTexFile (".mask.tex3", _mask);
-		for (unsigned int i = 0; i < _mask.size (); ++i){
-			_mask [i].clear ();
-		}
-		_mask.clear ();
+		_mask.reset ();
 
 		// finally write out the size and offset info for the subset volume
 		WriteInfoFile ();
@@ -107,18 +98,9 @@ namespace Sim {
 	// checks whether input parameters make sense
 	void VMProcessor::Cleanup ()
 	{
-		for (unsigned int i = 0; i < _ct.size (); ++i){
-			_ct [i].clear ();
-		}
-		_ct.clear ();
-		for (unsigned int i = 0; i < _rgb.size (); ++i){
-			_rgb [i].clear ();
-		}
-		_rgb.clear ();
-		for (unsigned int i = 0; i < _mask.size (); ++i){
-			_mask [i].clear ();
-		}
-		_mask.clear ();
+		_ct.reset ();
+		_rgb.reset ();
+		_mask.reset ();
 	}
 
 	bool VMProcessor::CheckSanity ()
@@ -198,9 +180,9 @@ namespace Sim {
 		_vDepth = isEven (_vDepth) ? _vDepth + 4 : _vDepth + 5;
 
 		// initialize and populate the mask layer (used later
-		_mask = vector < vector <unsigned char> > (_vDepth);
-		for (unsigned int i = 0; i < _vDepth; ++i){
-			_mask [i] = vector <unsigned char> (_vWidth * _vHeight, 0x00);
+		if (!_mask.Allocate (size_t (_vDepth)*_vWidth*_vHeight)){
+			LOG_ERROR ("Could not allocate mask volume");
+			return false;
 		}
 
 		// form the label mask volume
@@ -209,7 +191,7 @@ namespace Sim {
 			unsigned short label = static_cast <unsigned short> (labels [x]);
 			for (unsigned int i = _dBounds [0]; i <= _dBounds [1]; ++i){
 
-				unsigned char* cimage = &(_mask [i - _dBounds [0]  + _offset][0]);
+				unsigned char* cimage = Slice (_mask, i - _dBounds [0]  + _offset, 1);
 				unsigned short* image = &(mask [i][0]);
 
 				for (unsigned int j = _hBounds [0]; j <= _hBounds [1]; ++j){
@@ -253,17 +235,17 @@ namespace Sim {
     }
 
 		// initialize output rgb volume
-		_rgb = vector < vector <unsigned char> > (_vDepth);
-		for (unsigned int i = 0; i < _vDepth; ++i){
-			_rgb [i] = vector <unsigned char> (4 * _vWidth * _vHeight, 0x00);
+		if (!_rgb.Allocate (4*size_t (_vDepth)*_vWidth*_vHeight)){
+			LOG_ERROR ("Could not allocate rgb volume");
+			return false;
 		}
 
 
 		for (unsigned int i = _offset; i <= _dBounds [1] - _dBounds [0] + _offset; ++i){
 
-			unsigned char* msk = &(_mask [i][0]);
+			unsigned char* msk = Slice (_mask, i, 1);
 			unsigned char* col = &(rgb [i][0]);
-			unsigned char* cvol = &(_rgb [i][0]);
+			unsigned char* cvol = Slice (_rgb, i, 4);
 			unsigned ind = 0;
 
 			for (unsigned int j = _hBounds [0]; j <= _hBounds [1]; ++j){
@@ -309,15 +291,15 @@ namespace Sim {
 			}
     }
 
-		_ct = vector < vector <unsigned char> > (_vDepth);
-		for (unsigned int i = 0; i < _vDepth; ++i){
-			_ct [i] = vector <unsigned char> (4 * _vWidth * _vHeight, 0x00);
+		if (!_ct.Allocate (4*size_t (_vDepth)*_vWidth*_vHeight)){
+			LOG_ERROR ("Could not allocate ct volume");
+			return false;
 		}
 
 		for (unsigned int i = _offset; i <= _dBounds [1] - _dBounds [0] + _offset; ++i){
-			unsigned char* msk = &(_mask [i][0]);
+			unsigned char* msk = Slice (_mask, i, 1);
 			unsigned char* gray = &(ct [i][0]);
-			unsigned char* gvol = &(_ct [i][0]);
+			unsigned char* gvol = Slice (_ct, i, 4);
 			unsigned ind = 0;
 
 			for (unsigned int j = _hBounds [0]; j <= _hBounds [1]; ++j){
@@ -345,20 +327,21 @@ namespace Sim {
 
 	bool VMProcessor::ConnectedComponents ()
 	{
-		vector <vector <bool> > visited (_mask.size ());
+		vector <vector <bool> > visited (_vDepth);
 
 		// make all 0-valued voxels as visited
 		unsigned int count = 0;
 		bool found = false;
 		unsigned int first [3] = {0, 0, 0};
 
-		for (unsigned int i = 0; i < _mask.size (); ++i){
-			visited [i] = vector <bool> (_mask [i].size (), false);
+		for (unsigned int i = 0; i < _vDepth; ++i){
+			visited [i] = vector <bool> (_vWidth*_vHeight, false);
+			unsigned char* msk = Slice (_mask, i, 1);
 
 			for (unsigned int j = 0; j < _vHeight; ++j){
 				for (unsigned int k = 0; k < _vWidth; ++k){
 
-					if (!_mask [i][j*_vWidth + k]){
+					if (!msk [j*_vWidth + k]){
 						visited [i][j*_vWidth + k] = true;
 					}
 					else {
@@ -372,7 +355,7 @@ namespace Sim {
 				}
 			}
 		}
-		LOG (count << " non-zero voxels found out of a total of " << _mask.size ()*_mask [0].size ());
+		LOG (count << " non-zero voxels found out of a total of " << _mask.size ());
 
 		// do a breadth-first traversal to find connected components
 		int indices [27];
@@ -426,7 +409,7 @@ namespace Sim {
 		return true;
 	}
 
-	bool VMProcessor::WriteTexFile (const char* suffix, vector <vector <unsigned char> >& data)
+	bool VMProcessor::WriteTexFile (const char* suffix, const HugeBuffer <unsigned char>& data)
 	{
 		string filename (_outfolder + _prefix);
 		filename += suffix;
@@ -436,9 +419,7 @@ namespace Sim {
 			LOG_ERROR ("Could not open " << filename);
 			return false;
 		}
-		for (unsigned int i = 0; i < data.size (); ++i){
-			file.write (reinterpret_cast <char*>(&(data [i])), data [i].size ());
-		}
+		file.write (reinterpret_cast <const char*> (data.get ()), data.size ());
 
 		file.close ();
 		return true;
@@ -459,8 +440,12 @@ namespace Sim {
 			file += std::to_string (i);
 			file += ".png";
 
+			// the encoder works on a standalone slice
+			unsigned char* slice = Slice (_rgb, i, 4);
+			vector <unsigned char> data (slice, slice + 4*_vWidth*_vHeight);
+
 			PNGEncoder enc (file.c_str (), _vWidth, _vHeight);
-			if (!enc (_rgb [i])){
+			if (!enc (data)){
 				LOG_ERROR ("Could not write to " << file);
 				return false;
 			}
@@ -6,13 +6,16 @@
  *
  * @section DESCRIPTION
  * The voxel processor class for VoxelMan. This reads all the voxel data
- * and converts them to datasets for individual organs.
+ * and converts them to datasets for individual organs. The output
+ * volumes are kept in single contiguous, huge-page backed buffers.
  */
 #pragma once
 
 #include <vector>
 #include <string>
 
+#include "Memory/HugePage.h"
+
 namespace Sim {
 
 	class VMProcessor {
@@ -26,7 +29,8 @@ namespace Sim {
 
 		const unsigned int _offset = 2;
 		unsigned int _vWidth = 0, _vHeight = 0, _vDepth = 0;
-		std::vector < std::vector <unsigned char> > _mask, _rgb, _ct;
+		// mask is one byte per voxel, rgb and ct volumes are RGBA
+		HugeBuffer <unsigned char> _mask, _rgb, _ct;
 
 		// input related strings
 		std::string _ctfolder, _maskfolder, _rgbfolder;
@@ -67,10 +71,16 @@ namespace Sim {
 
 		bool ReadPngFile (const char* file, std::vector <unsigned char>& data);
 		bool ReadTiffFile (const char* file, std::vector <unsigned short>& data);
-		bool WriteTexFile (const char* suffix, std::vector <std::vector <unsigned char> >& data);
+		bool WriteTexFile (const char* suffix, const HugeBuffer <unsigned char>& data);
 
 		bool WritePngStack ();
 
 		bool WriteInfoFile ();
+
+		// pointer to slice 'i' of a volume with 'channels' bytes per voxel
+		unsigned char* Slice (HugeBuffer <unsigned char>& volume, unsigned int i, unsigned int channels)
+		{
+			return volume.get () + size_t (i)*channels*_vWidth*_vHeight;
+		}
 	};
 }